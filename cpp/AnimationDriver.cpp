@@ -0,0 +1,673 @@
+#include "AnimationDriver.hpp"
+#include "Color.hpp"
+#include "StyleKeys.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <variant>
+
+namespace margelo::nitro::cssnitro {
+
+    using AnyArray = ::margelo::nitro::AnyArray;
+    using AnyObject = ::margelo::nitro::AnyObject;
+    using AnyValue = ::margelo::nitro::AnyValue;
+
+    namespace {
+
+        bool toNumber(const AnyValue &value, double &out) {
+            if (std::holds_alternative<double>(value)) {
+                out = std::get<double>(value);
+                return true;
+            }
+            if (std::holds_alternative<int64_t>(value)) {
+                out = static_cast<double>(std::get<int64_t>(value));
+                return true;
+            }
+            return false;
+        }
+
+        // Split "45deg" into 45 and "deg"
+        bool splitUnit(const std::string &value, double &number, std::string &unit) {
+            const char *begin = value.c_str();
+            char *end = nullptr;
+            number = std::strtod(begin, &end);
+            if (end == begin) {
+                return false;
+            }
+            unit.assign(end);
+            return true;
+        }
+
+        std::string formatNumber(double value) {
+            char buffer[32];
+            std::snprintf(buffer, sizeof(buffer), "%.6g", value);
+            return buffer;
+        }
+
+        // A list property holds one value per animation, repeated to match animation-name
+        const AnyValue &listItem(const std::unordered_map<std::string, AnyValue> &style,
+                                 const std::string &property, size_t index) {
+            static const AnyValue missing;
+            auto it = style.find(property);
+            if (it == style.end()) {
+                return missing;
+            }
+            const AnyValue &value = it->second;
+            if (!std::holds_alternative<AnyArray>(value)) {
+                return value;
+            }
+            const auto &arr = std::get<AnyArray>(value);
+            // A function such as ["fn", "cubicBezier", ...] is a single item, not a list
+            if (arr.empty() ||
+                (std::holds_alternative<std::string>(arr[0]) &&
+                 std::get<std::string>(arr[0]) == "fn")) {
+                return value;
+            }
+            return arr[index % arr.size()];
+        }
+
+        double keyframeOffset(std::string selector) {
+            selector.erase(0, selector.find_first_not_of(" \t"));
+            selector.erase(selector.find_last_not_of(" \t") + 1);
+            if (selector == "from") {
+                return 0;
+            }
+            if (selector == "to") {
+                return 1;
+            }
+            double offset = std::strtod(selector.c_str(), nullptr);
+            if (!selector.empty() && selector.back() == '%') {
+                offset /= 100;
+            }
+            return offset;
+        }
+
+        // The style key of a CSS property name, e.g. "background-color" -> "backgroundColor".
+        // The individual transform properties all end up in "transform".
+        std::string styleKey(const std::string &property) {
+            if (property == "translate" || property == "rotate" || property == "scale") {
+                return "transform";
+            }
+            std::string key;
+            key.reserve(property.size());
+            bool upper = false;
+            for (char c: property) {
+                if (c == '-') {
+                    upper = !key.empty();
+                    continue;
+                }
+                key.push_back(upper ? static_cast<char>(::toupper(static_cast<unsigned char>(c)))
+                                    : c);
+                upper = false;
+            }
+            return key;
+        }
+
+    } // namespace
+
+    double AnimationDriver::steadyClock() {
+        using namespace std::chrono;
+        return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    AnimationDriver::AnimationDriver(Clock clock) : clock_(std::move(clock)) {}
+
+    bool AnimationDriver::isAnimationProperty(const std::string &property) {
+        return property == "animationName" || property == "animationDuration" ||
+               property == "animationDelay" || property == "animationIterationCount" ||
+               property == "animationDirection" || property == "animationFillMode" ||
+               property == "animationTimingFunction" || property == "animationPlayState";
+    }
+
+    bool AnimationDriver::isTransitionProperty(const std::string &property) {
+        return property == "transitionProperty" || property == "transitionDuration" ||
+               property == "transitionDelay" || property == "transitionTimingFunction" ||
+               property == "transitionBehavior";
+    }
+
+    std::vector<TransitionSpec> AnimationDriver::parseTransitions(
+            const std::unordered_map<std::string, AnyValue> &style) {
+        std::vector<TransitionSpec> transitions;
+
+        auto propertyIt = style.find("transitionProperty");
+        if (propertyIt == style.end()) {
+            return transitions;
+        }
+
+        std::vector<std::string> properties;
+        if (std::holds_alternative<std::string>(propertyIt->second)) {
+            properties.push_back(std::get<std::string>(propertyIt->second));
+        } else if (std::holds_alternative<AnyArray>(propertyIt->second)) {
+            for (const auto &property: std::get<AnyArray>(propertyIt->second)) {
+                properties.push_back(std::holds_alternative<std::string>(property)
+                                     ? std::get<std::string>(property) : "none");
+            }
+        }
+
+        for (size_t i = 0; i < properties.size(); i++) {
+            if (properties[i] == "none" || properties[i].empty()) {
+                continue;
+            }
+
+            TransitionSpec spec;
+            spec.property = styleKey(properties[i]);
+
+            double number = 0;
+            if (toNumber(listItem(style, "transitionDuration", i), number)) {
+                spec.duration = std::max(number, 0.0);
+            }
+            if (toNumber(listItem(style, "transitionDelay", i), number)) {
+                spec.delay = number;
+            }
+
+            const AnyValue &timingFunction = listItem(style, "transitionTimingFunction", i);
+            if (!std::holds_alternative<std::monostate>(timingFunction)) {
+                spec.timingFunction = timingFunction;
+            }
+
+            transitions.push_back(std::move(spec));
+        }
+
+        return transitions;
+    }
+
+    std::vector<Keyframe> AnimationDriver::parseKeyframes(const AnyObject &keyframes) {
+        std::vector<Keyframe> result;
+        for (const auto &entry: keyframes) {
+            if (!std::holds_alternative<AnyObject>(entry.second)) {
+                continue;
+            }
+            const auto &values = std::get<AnyObject>(entry.second);
+
+            size_t start = 0;
+            while (start <= entry.first.size()) {
+                size_t comma = entry.first.find(',', start);
+                if (comma == std::string::npos) {
+                    comma = entry.first.size();
+                }
+                double offset = keyframeOffset(entry.first.substr(start, comma - start));
+                if (offset >= 0 && offset <= 1) {
+                    result.push_back(Keyframe{offset, values});
+                }
+                start = comma + 1;
+            }
+        }
+
+        std::stable_sort(result.begin(), result.end(), [](const Keyframe &a, const Keyframe &b) {
+            return a.offset < b.offset;
+        });
+        return result;
+    }
+
+    std::vector<AnimationSpec> AnimationDriver::parseAnimations(
+            const std::unordered_map<std::string, AnyValue> &style,
+            const std::function<AnyObject(const std::string &)> &keyframesFor) {
+        std::vector<AnimationSpec> animations;
+
+        auto nameIt = style.find("animationName");
+        if (nameIt == style.end()) {
+            return animations;
+        }
+
+        std::vector<std::string> names;
+        if (std::holds_alternative<std::string>(nameIt->second)) {
+            names.push_back(std::get<std::string>(nameIt->second));
+        } else if (std::holds_alternative<AnyArray>(nameIt->second)) {
+            for (const auto &name: std::get<AnyArray>(nameIt->second)) {
+                names.push_back(std::holds_alternative<std::string>(name)
+                                ? std::get<std::string>(name) : "none");
+            }
+        }
+
+        for (size_t i = 0; i < names.size(); i++) {
+            if (names[i] == "none" || names[i].empty()) {
+                continue;
+            }
+
+            AnimationSpec spec;
+            spec.name = names[i];
+            spec.keyframes = parseKeyframes(keyframesFor(names[i]));
+
+            double number = 0;
+            if (toNumber(listItem(style, "animationDuration", i), number)) {
+                spec.duration = std::max(number, 0.0);
+            }
+            if (toNumber(listItem(style, "animationDelay", i), number)) {
+                spec.delay = number;
+            }
+
+            const AnyValue &iterations = listItem(style, "animationIterationCount", i);
+            if (toNumber(iterations, number)) {
+                spec.iterations = std::max(number, 0.0);
+            } else if (std::holds_alternative<std::string>(iterations) &&
+                       std::get<std::string>(iterations) == "infinite") {
+                spec.iterations = std::numeric_limits<double>::infinity();
+            }
+
+            const AnyValue &direction = listItem(style, "animationDirection", i);
+            if (std::holds_alternative<std::string>(direction)) {
+                const auto &value = std::get<std::string>(direction);
+                if (value == "reverse") {
+                    spec.direction = AnimationDirection::Reverse;
+                } else if (value == "alternate") {
+                    spec.direction = AnimationDirection::Alternate;
+                } else if (value == "alternate-reverse") {
+                    spec.direction = AnimationDirection::AlternateReverse;
+                }
+            }
+
+            const AnyValue &fillMode = listItem(style, "animationFillMode", i);
+            if (std::holds_alternative<std::string>(fillMode)) {
+                const auto &value = std::get<std::string>(fillMode);
+                if (value == "forwards") {
+                    spec.fillMode = AnimationFillMode::Forwards;
+                } else if (value == "backwards") {
+                    spec.fillMode = AnimationFillMode::Backwards;
+                } else if (value == "both") {
+                    spec.fillMode = AnimationFillMode::Both;
+                }
+            }
+
+            const AnyValue &timingFunction = listItem(style, "animationTimingFunction", i);
+            if (!std::holds_alternative<std::monostate>(timingFunction)) {
+                spec.timingFunction = timingFunction;
+            }
+
+            animations.push_back(std::move(spec));
+        }
+
+        return animations;
+    }
+
+    AnyValue AnimationDriver::interpolate(const std::string &property, const AnyValue &from,
+                                          const AnyValue &to, double progress) {
+        double fromNumber = 0;
+        double toNumberValue = 0;
+        if (toNumber(from, fromNumber) && toNumber(to, toNumberValue)) {
+            return fromNumber + (toNumberValue - fromNumber) * progress;
+        }
+
+        if (std::holds_alternative<std::string>(from) && std::holds_alternative<std::string>(to)) {
+            const auto &fromString = std::get<std::string>(from);
+            const auto &toString = std::get<std::string>(to);
+
+            if (StyleKeys::isColor(property)) {
+                auto fromColor = Color::parse(fromString);
+                auto toColor = Color::parse(toString);
+                if (fromColor && toColor) {
+                    return Color::toString(Color::mix(*fromColor, *toColor, progress));
+                }
+            }
+
+            std::string fromUnit;
+            std::string toUnit;
+            if (splitUnit(fromString, fromNumber, fromUnit) &&
+                splitUnit(toString, toNumberValue, toUnit) && fromUnit == toUnit) {
+                return formatNumber(fromNumber + (toNumberValue - fromNumber) * progress) + fromUnit;
+            }
+        }
+
+        // Transform lists are interpolated function by function when their shapes match
+        if (std::holds_alternative<AnyArray>(from) && std::holds_alternative<AnyArray>(to)) {
+            const auto &fromList = std::get<AnyArray>(from);
+            const auto &toList = std::get<AnyArray>(to);
+            if (fromList.size() == toList.size()) {
+                AnyArray result;
+                result.reserve(fromList.size());
+                for (size_t i = 0; i < fromList.size(); i++) {
+                    if (!std::holds_alternative<AnyObject>(fromList[i]) ||
+                        !std::holds_alternative<AnyObject>(toList[i])) {
+                        break;
+                    }
+                    const auto &fromItem = std::get<AnyObject>(fromList[i]);
+                    const auto &toItem = std::get<AnyObject>(toList[i]);
+                    if (fromItem.size() != 1 || toItem.size() != 1 ||
+                        fromItem.begin()->first != toItem.begin()->first) {
+                        break;
+                    }
+                    const auto &key = fromItem.begin()->first;
+                    AnyObject item;
+                    item[key] = interpolate(key, fromItem.begin()->second,
+                                            toItem.begin()->second, progress);
+                    result.emplace_back(std::move(item));
+                }
+                if (result.size() == fromList.size()) {
+                    return result;
+                }
+            }
+        }
+
+        // Objects such as shadowOffset are interpolated key by key
+        if (std::holds_alternative<AnyObject>(from) && std::holds_alternative<AnyObject>(to)) {
+            const auto &fromObject = std::get<AnyObject>(from);
+            const auto &toObject = std::get<AnyObject>(to);
+            if (fromObject.size() == toObject.size()) {
+                AnyObject result;
+                for (const auto &entry: fromObject) {
+                    auto toIt = toObject.find(entry.first);
+                    if (toIt == toObject.end()) {
+                        break;
+                    }
+                    result[entry.first] = interpolate(entry.first, entry.second, toIt->second,
+                                                      progress);
+                }
+                if (result.size() == fromObject.size()) {
+                    return result;
+                }
+            }
+        }
+
+        // Discrete values flip halfway through
+        return progress < 0.5 ? from : to;
+    }
+
+    bool AnimationDriver::sampleAnimation(const RunningAnimation &animation, double now,
+                                          AnyObject &frame) {
+        const AnimationSpec &spec = animation.spec;
+        const double elapsed = now - animation.startTime - spec.delay;
+        const double activeDuration =
+                spec.duration > 0 && spec.iterations > 0 ? spec.duration * spec.iterations : 0;
+        const bool running = elapsed < activeDuration;
+
+        double iteration = 0;
+        double progress = 0;
+        if (elapsed < 0) {
+            if (spec.fillMode != AnimationFillMode::Backwards &&
+                spec.fillMode != AnimationFillMode::Both) {
+                return running;
+            }
+        } else if (elapsed >= activeDuration) {
+            if (spec.fillMode != AnimationFillMode::Forwards &&
+                spec.fillMode != AnimationFillMode::Both) {
+                return running;
+            }
+            if (std::isinf(spec.iterations)) {
+                // Only a zero duration ends an infinite animation, inf - inf would be NaN.
+                // It rests at the end of an iteration.
+                progress = 1;
+            } else if (spec.iterations > 0) {
+                double whole = std::floor(spec.iterations);
+                progress = spec.iterations - whole;
+                iteration = whole;
+                if (progress == 0) {
+                    progress = 1;
+                    iteration = whole - 1;
+                }
+            }
+        } else {
+            double overall = elapsed / spec.duration;
+            iteration = std::floor(overall);
+            progress = overall - iteration;
+        }
+
+        const bool odd = std::fmod(iteration, 2) == 1;
+        const bool reversed = spec.direction == AnimationDirection::Reverse ||
+                              (spec.direction == AnimationDirection::Alternate && odd) ||
+                              (spec.direction == AnimationDirection::AlternateReverse && !odd);
+        if (reversed) {
+            progress = 1 - progress;
+        }
+
+        // Each property is interpolated between the closest keyframes that set it,
+        // frame starts empty so a property already in it has been sampled
+        for (const Keyframe &keyframe: spec.keyframes) {
+            for (const auto &entry: keyframe.values) {
+                const std::string &property = entry.first;
+                if (frame.count(property) > 0) {
+                    continue;
+                }
+
+                const Keyframe *before = nullptr;
+                const Keyframe *after = nullptr;
+                for (const Keyframe &candidate: spec.keyframes) {
+                    if (candidate.values.count(property) == 0) {
+                        continue;
+                    }
+                    if (candidate.offset <= progress) {
+                        before = &candidate;
+                    }
+                    if (candidate.offset >= progress && after == nullptr) {
+                        after = &candidate;
+                    }
+                }
+                if (before == nullptr) before = after;
+                if (after == nullptr) after = before;
+
+                const AnyValue &fromValue = before->values.at(property);
+                const AnyValue &toValue = after->values.at(property);
+                if (before == after || after->offset <= before->offset) {
+                    frame[property] = fromValue;
+                    continue;
+                }
+
+                double local = (progress - before->offset) / (after->offset - before->offset);
+                frame[property] = interpolate(property, fromValue, toValue,
+                                              animation.easing(local));
+            }
+        }
+
+        return running;
+    }
+
+    AnyValue AnimationDriver::sampleTransition(const std::string &property,
+                                               const RunningTransition &transition, double now) {
+        const double elapsed = now - transition.startTime - transition.delay;
+        // The start value holds during the delay
+        if (elapsed <= 0) {
+            return transition.from;
+        }
+        return interpolate(property, transition.from, transition.to,
+                           transition.easing(std::min(elapsed / transition.duration, 1.0)));
+    }
+
+    AnyObject AnimationDriver::sample(ComponentAnimations &component, double now) {
+        AnyObject frame;
+        bool running = false;
+
+        for (auto it = component.transitions.begin(); it != component.transitions.end();) {
+            const RunningTransition &transition = it->second;
+            if (now - transition.startTime - transition.delay >= transition.duration) {
+                // Ended, the base value now applies
+                it = component.transitions.erase(it);
+                continue;
+            }
+            frame[it->first] = sampleTransition(it->first, transition, now);
+            running = true;
+            ++it;
+        }
+
+        for (const auto &animation: component.animations) {
+            // Later animations override the properties of earlier ones
+            AnyObject animationFrame;
+            running = sampleAnimation(animation, now, animationFrame) || running;
+            for (auto &entry: animationFrame) {
+                frame[entry.first] = std::move(entry.second);
+            }
+        }
+
+        component.running = running;
+        return frame;
+    }
+
+    const TransitionSpec *AnimationDriver::findTransition(const std::vector<TransitionSpec> &specs,
+                                                          const std::string &property) {
+        const TransitionSpec *found = nullptr;
+        for (const auto &spec: specs) {
+            // A shorthand such as "margin" covers "marginTop", "marginBottom", ...
+            bool matches = spec.property == "all" || spec.property == property ||
+                           (property.size() > spec.property.size() &&
+                            property.compare(0, spec.property.size(), spec.property) == 0 &&
+                            std::isupper(static_cast<unsigned char>(property[spec.property.size()])));
+            if (matches) {
+                found = &spec;
+            }
+        }
+        return found;
+    }
+
+    void AnimationDriver::updateTransitions(ComponentAnimations &component,
+                                            std::vector<TransitionSpec> transitions,
+                                            const AnyObject &base, double now) {
+        AnyObject targets;
+
+        for (const auto &entry: base) {
+            const TransitionSpec *spec = findTransition(transitions, entry.first);
+            if (spec == nullptr) {
+                continue;
+            }
+            targets[entry.first] = entry.second;
+
+            auto previous = component.targets.find(entry.first);
+            if (previous == component.targets.end() || previous->second == entry.second) {
+                continue;
+            }
+
+            // Start from what is on screen, which may be a running transition
+            AnyValue from = previous->second;
+            auto running = component.transitions.find(entry.first);
+            if (running != component.transitions.end()) {
+                from = sampleTransition(entry.first, running->second, now);
+            }
+
+            if (spec->duration <= 0) {
+                component.transitions.erase(entry.first);
+                continue;
+            }
+            component.transitions[entry.first] = RunningTransition{
+                    std::move(from), entry.second, Easing::parse(spec->timingFunction),
+                    now, spec->duration, spec->delay};
+        }
+
+        // Properties that are no longer transitioned, or no longer set, jump to their value
+        for (auto it = component.transitions.begin(); it != component.transitions.end();) {
+            if (targets.count(it->first) == 0) {
+                it = component.transitions.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        component.targets = std::move(targets);
+        component.transitionSpecs = std::move(transitions);
+    }
+
+    void AnimationDriver::restoreRemoved(const ComponentAnimations &component, AnyObject &frame) {
+        for (const auto &entry: component.lastFrame) {
+            if (frame.count(entry.first) > 0) {
+                continue;
+            }
+            auto baseIt = component.base.find(entry.first);
+            frame[entry.first] = baseIt != component.base.end() ? baseIt->second : AnyValue();
+        }
+    }
+
+    AnyObject AnimationDriver::animate(const std::string &componentId,
+                                       std::vector<AnimationSpec> animations,
+                                       std::vector<TransitionSpec> transitions,
+                                       const AnyObject &base) {
+        const bool wasActive = active();
+
+        if (animations.empty() && transitions.empty()) {
+            auto it = components_.find(componentId);
+            if (it == components_.end()) {
+                return {};
+            }
+            it->second.base = base;
+            AnyObject frame;
+            restoreRemoved(it->second, frame);
+            components_.erase(it);
+            return frame;
+        }
+
+        const double now = clock_();
+        auto &component = components_[componentId];
+
+        std::vector<RunningAnimation> next;
+        next.reserve(animations.size());
+        for (size_t i = 0; i < animations.size(); i++) {
+            AnimationSpec &spec = animations[i];
+            // An animation keeps its start time while its name stays at the same position
+            if (i < component.animations.size() &&
+                component.animations[i].spec.name == spec.name) {
+                RunningAnimation &current = component.animations[i];
+                Easing::Function easing = current.spec.timingFunction == spec.timingFunction
+                                          ? current.easing
+                                          : Easing::parse(spec.timingFunction);
+                next.push_back(RunningAnimation{std::move(spec), std::move(easing),
+                                                current.startTime});
+            } else {
+                Easing::Function easing = Easing::parse(spec.timingFunction);
+                next.push_back(RunningAnimation{std::move(spec), std::move(easing), now});
+            }
+        }
+
+        component.animations = std::move(next);
+        updateTransitions(component, std::move(transitions), base, now);
+        component.base = base;
+
+        AnyObject frame = sample(component, now);
+        AnyObject result = frame;
+        restoreRemoved(component, result);
+        component.lastFrame = std::move(frame);
+
+        notifyIfActivated(wasActive);
+        return result;
+    }
+
+    void AnimationDriver::stop(const std::string &componentId) {
+        components_.erase(componentId);
+    }
+
+    bool AnimationDriver::isAnimating(const std::string &componentId) const {
+        return components_.count(componentId) > 0;
+    }
+
+    bool AnimationDriver::active() const {
+        return std::any_of(components_.begin(), components_.end(), [](const auto &entry) {
+            return entry.second.running;
+        });
+    }
+
+    AnimationDriver::Frames AnimationDriver::tick() {
+        Frames frames;
+        const double now = clock_();
+
+        for (auto &entry: components_) {
+            ComponentAnimations &component = entry.second;
+            if (!component.running) {
+                continue;
+            }
+
+            AnyObject frame = sample(component, now);
+            if (frame == component.lastFrame) {
+                continue;
+            }
+
+            AnyObject result = frame;
+            restoreRemoved(component, result);
+            component.lastFrame = std::move(frame);
+            frames.emplace_back(entry.first, std::move(result));
+        }
+
+        return frames;
+    }
+
+    size_t AnimationDriver::size() const {
+        return components_.size();
+    }
+
+    void AnimationDriver::setOnActive(std::function<void()> onActive) {
+        onActive_ = std::move(onActive);
+    }
+
+    void AnimationDriver::notifyIfActivated(bool wasActive) {
+        if (!wasActive && onActive_ && active()) {
+            onActive_();
+        }
+    }
+
+} // namespace margelo::nitro::cssnitro
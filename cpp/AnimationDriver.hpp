@@ -0,0 +1,188 @@
+#pragma once
+
+#include <functional>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <NitroModules/AnyMap.hpp>
+
+#include "Easing.hpp"
+
+namespace margelo::nitro::cssnitro {
+
+    enum class AnimationDirection {
+        Normal, Reverse, Alternate, AlternateReverse
+    };
+
+    enum class AnimationFillMode {
+        None, Forwards, Backwards, Both
+    };
+
+    // One keyframe of an animation, offset is between 0 and 1
+    struct Keyframe {
+        double offset;
+        margelo::nitro::AnyObject values;
+    };
+
+    // A single entry of animation-name with its matching animation-* values
+    struct AnimationSpec {
+        std::string name;
+        std::vector<Keyframe> keyframes;
+        double duration = 0; // ms
+        double delay = 0;    // ms
+        double iterations = 1; // infinity for "infinite"
+        AnimationDirection direction = AnimationDirection::Normal;
+        AnimationFillMode fillMode = AnimationFillMode::None;
+        margelo::nitro::AnyValue timingFunction = std::string("ease");
+    };
+
+    // A single entry of transition-property with its matching transition-* values
+    struct TransitionSpec {
+        std::string property; // a style key, e.g. "backgroundColor", "transform" or "all"
+        double duration = 0; // ms
+        double delay = 0;    // ms
+        margelo::nitro::AnyValue timingFunction = std::string("ease");
+    };
+
+    /**
+     * Interpolates CSS keyframe animations and transitions natively.
+     *
+     * The driver owns no thread and reads time only through its clock, so it can be
+     * stepped deterministically. Callers serialize access (HybridStyleRegistry drives it
+     * under its mutex, from the styled computeds and from its frame timer).
+     */
+    class AnimationDriver {
+    public:
+        using Clock = std::function<double()>;
+        using Frames = std::vector<std::pair<std::string, margelo::nitro::AnyObject>>;
+
+        // A monotonic clock in milliseconds
+        static double steadyClock();
+
+        explicit AnimationDriver(Clock clock = steadyClock);
+
+        /**
+         * Start, update or stop the animations and transitions of a component.
+         *
+         * An animation keeps running when its name stays at the same position, only its
+         * keyframes and options are updated. base holds the component's style without
+         * the animations, it is restored for properties once they stop being animated.
+         * A transitioned property whose base value changed starts a transition from the
+         * value currently on screen, including a transition that is still running.
+         *
+         * @return the style values to apply now: the current frame, plus the base value
+         *         (or null) of every property that is no longer animated
+         */
+        margelo::nitro::AnyObject animate(const std::string &componentId,
+                                          std::vector<AnimationSpec> animations,
+                                          std::vector<TransitionSpec> transitions,
+                                          const margelo::nitro::AnyObject &base);
+
+        void stop(const std::string &componentId);
+
+        // Does the component have a running animation, or a filled one holding its last frame?
+        bool isAnimating(const std::string &componentId) const;
+
+        // Is any animation still running, i.e. does tick() need to be called again?
+        bool active() const;
+
+        // Advance every animation to the clock's time, returns the frames that changed
+        Frames tick();
+
+        size_t size() const;
+
+        // Called when the driver goes from idle to active, e.g. to start a frame timer
+        void setOnActive(std::function<void()> onActive);
+
+        /**
+         * Build the animation specs from the animation-* properties of a resolved style.
+         * keyframesFor returns the resolved keyframes of an animation name.
+         */
+        static std::vector<AnimationSpec> parseAnimations(
+                const std::unordered_map<std::string, margelo::nitro::AnyValue> &style,
+                const std::function<margelo::nitro::AnyObject(const std::string &)> &keyframesFor);
+
+        // Build the transition specs from the transition-* properties of a resolved style
+        static std::vector<TransitionSpec> parseTransitions(
+                const std::unordered_map<std::string, margelo::nitro::AnyValue> &style);
+
+        // Keyframe selectors are "from", "to", "0.5", "50%" or a list of them, e.g. "0%, 100%"
+        static std::vector<Keyframe> parseKeyframes(const margelo::nitro::AnyObject &keyframes);
+
+        /**
+         * Interpolate a style value. Numbers, numbers with matching units ("45deg"),
+         * colors and transform lists are interpolated, anything else flips at 0.5.
+         */
+        static margelo::nitro::AnyValue interpolate(const std::string &property,
+                                                    const margelo::nitro::AnyValue &from,
+                                                    const margelo::nitro::AnyValue &to,
+                                                    double progress);
+
+        // The properties that hold animation-* values
+        static bool isAnimationProperty(const std::string &property);
+
+        // The properties that hold transition-* values
+        static bool isTransitionProperty(const std::string &property);
+
+    private:
+        struct RunningAnimation {
+            AnimationSpec spec;
+            Easing::Function easing;
+            double startTime;
+        };
+
+        struct RunningTransition {
+            margelo::nitro::AnyValue from;
+            margelo::nitro::AnyValue to;
+            Easing::Function easing;
+            double startTime;
+            double duration;
+            double delay;
+        };
+
+        struct ComponentAnimations {
+            std::vector<RunningAnimation> animations;
+            std::vector<TransitionSpec> transitionSpecs;
+            // The last base value of every transitioned property, the end of its transition
+            margelo::nitro::AnyObject targets;
+            std::unordered_map<std::string, RunningTransition> transitions;
+            margelo::nitro::AnyObject base;
+            margelo::nitro::AnyObject lastFrame;
+            bool running = false;
+        };
+
+        Clock clock_;
+        std::function<void()> onActive_;
+        std::unordered_map<std::string, ComponentAnimations> components_;
+
+        // The frame of a component at now: its transitions, overridden by its animations in
+        // order. Updates component.running and drops the transitions that have ended.
+        static margelo::nitro::AnyObject sample(ComponentAnimations &component, double now);
+
+        static bool sampleAnimation(const RunningAnimation &animation, double now,
+                                    margelo::nitro::AnyObject &frame);
+
+        static margelo::nitro::AnyValue sampleTransition(const std::string &property,
+                                                         const RunningTransition &transition,
+                                                         double now);
+
+        // The last spec of the list that applies to a style key, or nullptr
+        static const TransitionSpec *findTransition(const std::vector<TransitionSpec> &specs,
+                                                    const std::string &property);
+
+        // Start transitions for the transitioned properties whose base value changed
+        static void updateTransitions(ComponentAnimations &component,
+                                      std::vector<TransitionSpec> transitions,
+                                      const margelo::nitro::AnyObject &base, double now);
+
+        // Add the base value (or null) of every property of lastFrame that frame lacks
+        static void restoreRemoved(const ComponentAnimations &component,
+                                   margelo::nitro::AnyObject &frame);
+
+        void notifyIfActivated(bool wasActive);
+    };
+
+} // namespace margelo::nitro::cssnitro
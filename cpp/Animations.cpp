@@ -9,139 +9,205 @@ namespace reactnativecss::animations {
     using AnyValue = ::margelo::nitro::AnyValue;
     using AnyObject = ::margelo::nitro::AnyObject;
 
-    // Map to store the shared keyframes observables (one per keyframe name)
-    static std::unordered_map<std::string, std::shared_ptr<reactnativecss::Observable<std::shared_ptr<AnyMap>>>> keyframesObservables;
-
-    // Map to store scope-specific computeds: Map<variableScope, Map<name, Computed<AnyMap>>>
-    static std::unordered_map<std::string, std::unordered_map<std::string, std::shared_ptr<reactnativecss::Computed<std::shared_ptr<AnyMap>>>>> scopedComputeds;
-
-    void setKeyframes(const std::string &name, const std::shared_ptr<AnyMap> &keyframes) {
-        std::shared_ptr<reactnativecss::Observable<std::shared_ptr<AnyMap>>> observable;
+    using KeyframesComputed = reactnativecss::Computed<std::shared_ptr<AnyMap>>;
+
+    // The raw keyframes of a name, and whether resolving them depends on the variable scope
+    struct KeyframesEntry {
+        std::shared_ptr<reactnativecss::Observable<std::shared_ptr<AnyMap>>> raw;
+        std::shared_ptr<reactnativecss::Observable<bool>> scoped;
+        // Resolved once for every scope, used while the keyframes are not scoped
+        std::shared_ptr<KeyframesComputed> shared;
+    };
+
+    // Map to store the keyframes entries (one per keyframe name)
+    static std::unordered_map<std::string, KeyframesEntry> keyframesEntries;
+
+    // Map to store scope-specific computeds, only for keyframes that read the scope:
+    // Map<variableScope, Map<name, Computed<AnyMap>>>. Released by deleteScope.
+    static std::unordered_map<std::string, std::unordered_map<std::string, std::shared_ptr<KeyframesComputed>>> scopedComputeds;
+
+    // Does resolving this value depend on the variable scope (var() or em units)?
+    static bool readsScope(const AnyValue &value) {
+        if (std::holds_alternative<AnyObject>(value)) {
+            for (const auto &entry: std::get<AnyObject>(value)) {
+                if (readsScope(entry.second)) {
+                    return true;
+                }
+            }
+            return false;
+        }
 
-        // Find or create the observable for this keyframe name
-        auto it = keyframesObservables.find(name);
+        if (!std::holds_alternative<margelo::nitro::AnyArray>(value)) {
+            return false;
+        }
 
-        if (it != keyframesObservables.end()) {
-            observable = it->second;
-        } else {
-            // Create new observable
-            observable = reactnativecss::Observable<std::shared_ptr<AnyMap>>::create(keyframes);
-            keyframesObservables[name] = observable;
+        const auto &arr = std::get<margelo::nitro::AnyArray>(value);
+        if (arr.size() >= 2 && std::holds_alternative<std::string>(arr[1])) {
+            const auto &name = std::get<std::string>(arr[1]);
+            bool isFn = std::holds_alternative<std::string>(arr[0]) &&
+                        std::get<std::string>(arr[0]) == "fn";
+            bool isUnit = std::holds_alternative<AnyObject>(arr[0]);
+            if ((isFn && name == "var") || (isUnit && (name == "var" || name == "em"))) {
+                return true;
+            }
         }
 
-        // Batch the update to prevent cascade during fast refresh
-        if (observable) {
-            reactnativecss::Effect::batch([&]() {
-                observable->set(keyframes);
-            });
+        for (const auto &item: arr) {
+            if (readsScope(item)) {
+                return true;
+            }
         }
+        return false;
     }
 
-    std::shared_ptr<AnyMap> getKeyframes(const std::string &name, const std::string &variableScope,
-                                         reactnativecss::Effect::GetProxy &get) {
-        // First, ensure the Observable exists for this keyframe name
-        auto obsIt = keyframesObservables.find(name);
-        if (obsIt == keyframesObservables.end()) {
-            // Create a new observable with an empty AnyMap
-            keyframesObservables[name] = reactnativecss::Observable<std::shared_ptr<AnyMap>>::create(
-                    AnyMap::make());
-            obsIt = keyframesObservables.find(name);
+    static bool readsScope(const std::shared_ptr<AnyMap> &keyframes) {
+        if (!keyframes) {
+            return false;
         }
-
-        // Get the observable for this keyframe name
-        auto observable = obsIt->second;
-
-        // Now check if a Computed exists within the variableScope for this name
-        auto scopeIt = scopedComputeds.find(variableScope);
-        if (scopeIt == scopedComputeds.end()) {
-            // Create the scope map if it doesn't exist
-            scopedComputeds[variableScope] = std::unordered_map<std::string, std::shared_ptr<reactnativecss::Computed<std::shared_ptr<AnyMap>>>>();
-            scopeIt = scopedComputeds.find(variableScope);
+        for (const auto &entry: keyframes->getMap()) {
+            if (readsScope(entry.second)) {
+                return true;
+            }
         }
+        return false;
+    }
 
-        auto &scopeMap = scopeIt->second;
-        auto computedIt = scopeMap.find(name);
-
-        if (computedIt == scopeMap.end()) {
-            // Create a new Computed that gets the AnyMap from the observable and processes it
-            // Wrap in a batch to ensure the initial computation doesn't trigger cascades
-            std::shared_ptr<reactnativecss::Computed<std::shared_ptr<AnyMap>>> computed;
-
-            reactnativecss::Effect::batch([&]() {
-                computed = reactnativecss::Computed<std::shared_ptr<AnyMap>>::create(
-                        [observable, variableScope](const std::shared_ptr<AnyMap> &prev,
-                                                    reactnativecss::Effect::GetProxy &get) {
-                            // Get the raw keyframes from the observable
-                            auto rawKeyframes = get(*observable);
+    static KeyframesEntry &ensureEntry(const std::string &name) {
+        auto it = keyframesEntries.find(name);
+        if (it == keyframesEntries.end()) {
+            // Create a new entry with an empty AnyMap
+            KeyframesEntry entry;
+            entry.raw = reactnativecss::Observable<std::shared_ptr<AnyMap>>::create(AnyMap::make());
+            entry.scoped = reactnativecss::Observable<bool>::create(false);
+            it = keyframesEntries.emplace(name, std::move(entry)).first;
+        }
+        return it->second;
+    }
 
-                            // If keyframes are empty, return early to avoid unnecessary processing
-                            if (rawKeyframes->getMap().empty()) {
-                                return AnyMap::make();
+    static std::shared_ptr<KeyframesComputed>
+    createKeyframesComputed(const std::shared_ptr<reactnativecss::Observable<std::shared_ptr<AnyMap>>> &observable,
+                            const std::string &variableScope) {
+        // Create a new Computed that gets the AnyMap from the observable and processes it
+        // Wrap in a batch to ensure the initial computation doesn't trigger cascades
+        std::shared_ptr<KeyframesComputed> computed;
+
+        reactnativecss::Effect::batch([&]() {
+            computed = KeyframesComputed::create(
+                    [observable, variableScope](const std::shared_ptr<AnyMap> &prev,
+                                                reactnativecss::Effect::GetProxy &get) {
+                        // Get the raw keyframes from the observable
+                        auto rawKeyframes = get(*observable);
+
+                        // If keyframes are empty, return early to avoid unnecessary processing
+                        if (rawKeyframes->getMap().empty()) {
+                            return AnyMap::make();
+                        }
+
+                        // Create a new AnyMap to hold the resolved keyframes
+                        auto resolvedKeyframes = AnyMap::make(rawKeyframes->getMap().size());
+
+                        // Loop over the entries of the rawKeyframes
+                        for (const auto &entry: rawKeyframes->getMap()) {
+                            const std::string &key = entry.first;
+                            const AnyValue &value = entry.second;
+
+                            // Each value should be an AnyObject, if not skip that entry
+                            if (!std::holds_alternative<AnyObject>(value)) {
+                                continue;
                             }
 
-                            // Create a new AnyMap to hold the resolved keyframes
-                            auto resolvedKeyframes = AnyMap::make(rawKeyframes->getMap().size());
+                            const auto &frameMap = std::get<AnyObject>(value);
 
-                            // Loop over the entries of the rawKeyframes
-                            for (const auto &entry: rawKeyframes->getMap()) {
-                                const std::string &key = entry.first;
-                                const AnyValue &value = entry.second;
+                            // Create a temporary map to hold resolved frame values
+                            std::unordered_map<std::string, AnyValue> resolvedFrameMap;
+                            resolvedFrameMap.reserve(frameMap.size());
 
-                                // Each value should be an AnyObject, if not skip that entry
-                                if (!std::holds_alternative<AnyObject>(value)) {
-                                    continue;
-                                }
+                            // Loop over each entry of the frame and resolve values
+                            for (const auto &frameEntry: frameMap) {
+                                const std::string &frameKey = frameEntry.first;
+                                const AnyValue &frameValue = frameEntry.second;
 
-                                const auto &frameMap = std::get<AnyObject>(value);
+                                // Resolve the value using StyleResolver
+                                margelo::nitro::cssnitro::AnyValuePtr holder;
+                                const AnyValue &resolvedValue = margelo::nitro::cssnitro::StyleResolver::resolveStyle(
+                                        frameValue, variableScope, get, holder
+                                );
 
-                                // Create a temporary map to hold resolved frame values
-                                std::unordered_map<std::string, AnyValue> resolvedFrameMap;
-                                resolvedFrameMap.reserve(frameMap.size());
+                                resolvedFrameMap[frameKey] = resolvedValue;
+                            }
+
+                            // Apply style mapping to the resolved frame (don't process animations to avoid recursion)
+                            auto transformedFrame = margelo::nitro::cssnitro::StyleResolver::applyStyleMapping(
+                                    resolvedFrameMap, variableScope, get, false
+                            );
 
-                                // Loop over each entry of the frame and resolve values
-                                for (const auto &frameEntry: frameMap) {
-                                    const std::string &frameKey = frameEntry.first;
-                                    const AnyValue &frameValue = frameEntry.second;
+                            // Convert the transformed frame back to an AnyObject
+                            AnyObject finalFrame;
+                            for (const auto &transformedEntry: transformedFrame->getMap()) {
+                                finalFrame[transformedEntry.first] = transformedEntry.second;
+                            }
 
-                                    // Resolve the value using StyleResolver
-                                    AnyValue resolvedValue = margelo::nitro::cssnitro::StyleResolver::resolveStyle(
-                                            frameValue, variableScope, get
-                                    );
+                            // Set the resolved and transformed frame in the result
+                            resolvedKeyframes->setObject(key, finalFrame);
+                        }
 
-                                    resolvedFrameMap[frameKey] = resolvedValue;
-                                }
+                        return resolvedKeyframes;
+                    },
+                    AnyMap::make()
+            );
+        });
 
-                                // Apply style mapping to the resolved frame (don't process animations to avoid recursion)
-                                auto transformedFrame = margelo::nitro::cssnitro::StyleResolver::applyStyleMapping(
-                                        resolvedFrameMap, variableScope, get, false
-                                );
+        return computed;
+    }
 
-                                // Convert the transformed frame back to an AnyObject
-                                AnyObject finalFrame;
-                                for (const auto &transformedEntry: transformedFrame->getMap()) {
-                                    finalFrame[transformedEntry.first] = transformedEntry.second;
-                                }
+    void setKeyframes(const std::string &name, const std::shared_ptr<AnyMap> &keyframes) {
+        auto &entry = ensureEntry(name);
+        bool scoped = readsScope(keyframes);
+
+        // Per-scope copies are only needed while the keyframes read the scope
+        if (!scoped) {
+            for (auto &scope: scopedComputeds) {
+                scope.second.erase(name);
+            }
+        }
 
-                                // Set the resolved and transformed frame in the result
-                                resolvedKeyframes->setObject(key, finalFrame);
-                            }
+        // Batch the update to prevent cascade during fast refresh
+        reactnativecss::Effect::batch([&]() {
+            entry.scoped->set(scoped);
+            entry.raw->set(keyframes);
+        });
+    }
 
-                            return resolvedKeyframes;
-                        },
-                        AnyMap::make()
-                );
-            });
+    std::shared_ptr<AnyMap> getKeyframes(const std::string &name, const std::string &variableScope,
+                                         reactnativecss::Effect::GetProxy &get) {
+        // First, ensure the entry exists for this keyframe name
+        auto &entry = ensureEntry(name);
+
+        // Keyframes that don't read the scope are resolved once and shared by every scope
+        if (!get(*entry.scoped)) {
+            if (!entry.shared) {
+                entry.shared = createKeyframesComputed(entry.raw, "root");
+            }
+            return get(*entry.shared);
+        }
 
-            scopeMap[name] = computed;
-            computedIt = scopeMap.find(name);
+        // Now check if a Computed exists within the variableScope for this name
+        auto &scopeMap = scopedComputeds[variableScope];
+        auto &computed = scopeMap[name];
+        if (!computed) {
+            computed = createKeyframesComputed(entry.raw, variableScope);
         }
 
         // Return get(computed) to subscribe to it
-        return get(*computedIt->second);
+        return get(*computed);
     }
 
     void deleteScope(const std::string &name) {
         scopedComputeds.erase(name);
     }
 
+    size_t scopeCount() {
+        return scopedComputeds.size();
+    }
+
 } // namespace reactnativecss::animations
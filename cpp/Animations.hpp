@@ -13,4 +13,7 @@ namespace reactnativecss::animations {
                  reactnativecss::Effect::GetProxy &get);
 
     void deleteScope(const std::string &variableScope);
+
+    // The number of variable scopes holding resolved keyframes
+    size_t scopeCount();
 } // namespace reactnativecss::animations
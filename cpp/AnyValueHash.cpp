@@ -0,0 +1,49 @@
+#include "AnyValueHash.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <variant>
+
+namespace margelo::nitro::cssnitro {
+
+    namespace nitro_ns = ::margelo::nitro;
+
+    namespace {
+        // boost::hash_combine
+        size_t combine(size_t seed, size_t hash) {
+            return seed ^ (hash + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+        }
+    } // namespace
+
+    size_t AnyValueHash::operator()(const nitro_ns::AnyValue &value) const {
+        const auto &variant = static_cast<const nitro_ns::VariantType &>(value);
+        size_t hash = std::visit(
+                [this](const auto &arg) -> size_t {
+                    using T = std::decay_t<decltype(arg)>;
+                    if constexpr (std::is_same_v<T, std::monostate>) {
+                        return 0;
+                    } else if constexpr (std::is_same_v<T, nitro_ns::AnyArray>) {
+                        size_t seed = arg.size();
+                        for (const auto &element: arg) {
+                            seed = combine(seed, (*this)(element));
+                        }
+                        return seed;
+                    } else if constexpr (std::is_same_v<T, nitro_ns::AnyObject>) {
+                        // Summed, so the order the entries are visited in doesn't matter
+                        size_t sum = arg.size();
+                        for (const auto &entry: arg) {
+                            sum += combine(std::hash<std::string>{}(entry.first),
+                                           (*this)(entry.second));
+                        }
+                        return sum;
+                    } else {
+                        return std::hash<T>{}(arg);
+                    }
+                },
+                variant);
+        return combine(variant.index(), hash);
+    }
+
+} // namespace margelo::nitro::cssnitro
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+
+#include <NitroModules/AnyMap.hpp>
+
+namespace margelo::nitro::cssnitro {
+
+    /**
+     * A structural hash of an AnyValue, so values can key hash maps. Equal values hash
+     * equal: objects combine their entries independently of iteration order, and the
+     * alternative is mixed in since values of different types never compare equal.
+     */
+    struct AnyValueHash {
+        size_t operator()(const ::margelo::nitro::AnyValue &value) const;
+    };
+
+} // namespace margelo::nitro::cssnitro
@@ -0,0 +1,392 @@
+#include "Color.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <numbers>
+#include <unordered_map>
+#include <vector>
+
+namespace margelo::nitro::cssnitro {
+
+    static int hexDigit(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    static std::optional<Color::RGBA> parseHex(const std::string &value) {
+        const size_t length = value.size() - 1;
+        if (length != 3 && length != 4 && length != 6 && length != 8) {
+            return std::nullopt;
+        }
+
+        std::vector<int> channels;
+        const bool shorthand = length <= 4;
+        for (size_t i = 1; i < value.size(); i += shorthand ? 1 : 2) {
+            int high = hexDigit(value[i]);
+            int low = shorthand ? high : hexDigit(value[i + 1]);
+            if (high < 0 || low < 0) {
+                return std::nullopt;
+            }
+            channels.push_back(high * 16 + low);
+        }
+
+        Color::RGBA color{
+                static_cast<double>(channels[0]),
+                static_cast<double>(channels[1]),
+                static_cast<double>(channels[2]),
+                1};
+        if (channels.size() == 4) {
+            color.a = channels[3] / 255.0;
+        }
+        return color;
+    }
+
+    // The CSS named colors as 0xRRGGBB
+    static const std::unordered_map<std::string, uint32_t> &namedColors() {
+        static const std::unordered_map<std::string, uint32_t> colors = {
+                {"aliceblue", 0xf0f8ff},
+                {"antiquewhite", 0xfaebd7},
+                {"aqua", 0x00ffff},
+                {"aquamarine", 0x7fffd4},
+                {"azure", 0xf0ffff},
+                {"beige", 0xf5f5dc},
+                {"bisque", 0xffe4c4},
+                {"black", 0x000000},
+                {"blanchedalmond", 0xffebcd},
+                {"blue", 0x0000ff},
+                {"blueviolet", 0x8a2be2},
+                {"brown", 0xa52a2a},
+                {"burlywood", 0xdeb887},
+                {"cadetblue", 0x5f9ea0},
+                {"chartreuse", 0x7fff00},
+                {"chocolate", 0xd2691e},
+                {"coral", 0xff7f50},
+                {"cornflowerblue", 0x6495ed},
+                {"cornsilk", 0xfff8dc},
+                {"crimson", 0xdc143c},
+                {"cyan", 0x00ffff},
+                {"darkblue", 0x00008b},
+                {"darkcyan", 0x008b8b},
+                {"darkgoldenrod", 0xb8860b},
+                {"darkgray", 0xa9a9a9},
+                {"darkgreen", 0x006400},
+                {"darkgrey", 0xa9a9a9},
+                {"darkkhaki", 0xbdb76b},
+                {"darkmagenta", 0x8b008b},
+                {"darkolivegreen", 0x556b2f},
+                {"darkorange", 0xff8c00},
+                {"darkorchid", 0x9932cc},
+                {"darkred", 0x8b0000},
+                {"darksalmon", 0xe9967a},
+                {"darkseagreen", 0x8fbc8f},
+                {"darkslateblue", 0x483d8b},
+                {"darkslategray", 0x2f4f4f},
+                {"darkslategrey", 0x2f4f4f},
+                {"darkturquoise", 0x00ced1},
+                {"darkviolet", 0x9400d3},
+                {"deeppink", 0xff1493},
+                {"deepskyblue", 0x00bfff},
+                {"dimgray", 0x696969},
+                {"dimgrey", 0x696969},
+                {"dodgerblue", 0x1e90ff},
+                {"firebrick", 0xb22222},
+                {"floralwhite", 0xfffaf0},
+                {"forestgreen", 0x228b22},
+                {"fuchsia", 0xff00ff},
+                {"gainsboro", 0xdcdcdc},
+                {"ghostwhite", 0xf8f8ff},
+                {"gold", 0xffd700},
+                {"goldenrod", 0xdaa520},
+                {"gray", 0x808080},
+                {"green", 0x008000},
+                {"greenyellow", 0xadff2f},
+                {"grey", 0x808080},
+                {"honeydew", 0xf0fff0},
+                {"hotpink", 0xff69b4},
+                {"indianred", 0xcd5c5c},
+                {"indigo", 0x4b0082},
+                {"ivory", 0xfffff0},
+                {"khaki", 0xf0e68c},
+                {"lavender", 0xe6e6fa},
+                {"lavenderblush", 0xfff0f5},
+                {"lawngreen", 0x7cfc00},
+                {"lemonchiffon", 0xfffacd},
+                {"lightblue", 0xadd8e6},
+                {"lightcoral", 0xf08080},
+                {"lightcyan", 0xe0ffff},
+                {"lightgoldenrodyellow", 0xfafad2},
+                {"lightgray", 0xd3d3d3},
+                {"lightgreen", 0x90ee90},
+                {"lightgrey", 0xd3d3d3},
+                {"lightpink", 0xffb6c1},
+                {"lightsalmon", 0xffa07a},
+                {"lightseagreen", 0x20b2aa},
+                {"lightskyblue", 0x87cefa},
+                {"lightslategray", 0x778899},
+                {"lightslategrey", 0x778899},
+                {"lightsteelblue", 0xb0c4de},
+                {"lightyellow", 0xffffe0},
+                {"lime", 0x00ff00},
+                {"limegreen", 0x32cd32},
+                {"linen", 0xfaf0e6},
+                {"magenta", 0xff00ff},
+                {"maroon", 0x800000},
+                {"mediumaquamarine", 0x66cdaa},
+                {"mediumblue", 0x0000cd},
+                {"mediumorchid", 0xba55d3},
+                {"mediumpurple", 0x9370db},
+                {"mediumseagreen", 0x3cb371},
+                {"mediumslateblue", 0x7b68ee},
+                {"mediumspringgreen", 0x00fa9a},
+                {"mediumturquoise", 0x48d1cc},
+                {"mediumvioletred", 0xc71585},
+                {"midnightblue", 0x191970},
+                {"mintcream", 0xf5fffa},
+                {"mistyrose", 0xffe4e1},
+                {"moccasin", 0xffe4b5},
+                {"navajowhite", 0xffdead},
+                {"navy", 0x000080},
+                {"oldlace", 0xfdf5e6},
+                {"olive", 0x808000},
+                {"olivedrab", 0x6b8e23},
+                {"orange", 0xffa500},
+                {"orangered", 0xff4500},
+                {"orchid", 0xda70d6},
+                {"palegoldenrod", 0xeee8aa},
+                {"palegreen", 0x98fb98},
+                {"paleturquoise", 0xafeeee},
+                {"palevioletred", 0xdb7093},
+                {"papayawhip", 0xffefd5},
+                {"peachpuff", 0xffdab9},
+                {"peru", 0xcd853f},
+                {"pink", 0xffc0cb},
+                {"plum", 0xdda0dd},
+                {"powderblue", 0xb0e0e6},
+                {"purple", 0x800080},
+                {"rebeccapurple", 0x663399},
+                {"red", 0xff0000},
+                {"rosybrown", 0xbc8f8f},
+                {"royalblue", 0x4169e1},
+                {"saddlebrown", 0x8b4513},
+                {"salmon", 0xfa8072},
+                {"sandybrown", 0xf4a460},
+                {"seagreen", 0x2e8b57},
+                {"seashell", 0xfff5ee},
+                {"sienna", 0xa0522d},
+                {"silver", 0xc0c0c0},
+                {"skyblue", 0x87ceeb},
+                {"slateblue", 0x6a5acd},
+                {"slategray", 0x708090},
+                {"slategrey", 0x708090},
+                {"snow", 0xfffafa},
+                {"springgreen", 0x00ff7f},
+                {"steelblue", 0x4682b4},
+                {"tan", 0xd2b48c},
+                {"teal", 0x008080},
+                {"thistle", 0xd8bfd8},
+                {"tomato", 0xff6347},
+                {"turquoise", 0x40e0d0},
+                {"violet", 0xee82ee},
+                {"wheat", 0xf5deb3},
+                {"white", 0xffffff},
+                {"whitesmoke", 0xf5f5f5},
+                {"yellow", 0xffff00},
+                {"yellowgreen", 0x9acd32},
+        };
+        return colors;
+    }
+
+    // A numeric argument of a color function, e.g. 50% or 120deg
+    struct ColorComponent {
+        double value;
+        std::string unit;
+    };
+
+    // Split the arguments of rgb(255, 0, 0), rgba(255 0 0 / 0.5) or hsl(120deg 100% 50%)
+    static std::optional<std::vector<ColorComponent>> parseComponents(const std::string &value) {
+        auto open = value.find('(');
+        auto close = value.rfind(')');
+        if (open == std::string::npos || close == std::string::npos || close < open) {
+            return std::nullopt;
+        }
+
+        std::vector<ColorComponent> components;
+        const char *cursor = value.c_str() + open + 1;
+        const char *end = value.c_str() + close;
+        while (cursor < end) {
+            if (std::isspace(static_cast<unsigned char>(*cursor)) || *cursor == ',' ||
+                *cursor == '/') {
+                cursor++;
+                continue;
+            }
+            // "none" is a missing component, it behaves as 0
+            if (std::strncmp(cursor, "none", 4) == 0) {
+                components.push_back(ColorComponent{0, ""});
+                cursor += 4;
+                continue;
+            }
+            char *next = nullptr;
+            double number = std::strtod(cursor, &next);
+            if (next == cursor) {
+                return std::nullopt;
+            }
+            const char *unitEnd = next;
+            while (unitEnd < end && (std::isalpha(static_cast<unsigned char>(*unitEnd)) ||
+                                     *unitEnd == '%')) {
+                unitEnd++;
+            }
+            components.push_back(ColorComponent{number, std::string(static_cast<const char *>(next), unitEnd)});
+            cursor = unitEnd;
+        }
+
+        if (components.size() != 3 && components.size() != 4) {
+            return std::nullopt;
+        }
+        return components;
+    }
+
+    static double alphaComponent(const std::vector<ColorComponent> &components) {
+        if (components.size() < 4) {
+            return 1;
+        }
+        const auto &alpha = components[3];
+        return std::clamp(alpha.unit == "%" ? alpha.value / 100 : alpha.value, 0.0, 1.0);
+    }
+
+    // Hue in degrees, from deg, rad, grad, turn or a unitless number
+    static double hueComponent(const ColorComponent &hue) {
+        double degrees = hue.value;
+        if (hue.unit == "rad") {
+            degrees = hue.value * 180 / std::numbers::pi;
+        } else if (hue.unit == "grad") {
+            degrees = hue.value * 0.9;
+        } else if (hue.unit == "turn") {
+            degrees = hue.value * 360;
+        }
+        degrees = std::fmod(degrees, 360);
+        return degrees < 0 ? degrees + 360 : degrees;
+    }
+
+    // A 0-1 fraction from a percentage (or a plain number, as in the relative color syntax)
+    static double fractionComponent(const ColorComponent &component) {
+        double value = component.unit == "%" ? component.value / 100 : component.value;
+        return std::clamp(value, 0.0, 1.0);
+    }
+
+    // sRGB channels (0-255) of a hue with saturation and lightness as 0-1 fractions
+    static Color::RGBA hslToRgb(double hue, double saturation, double lightness, double alpha) {
+        auto channel = [&](double n) {
+            double k = std::fmod(n + hue / 30, 12);
+            double a = saturation * std::min(lightness, 1 - lightness);
+            return (lightness - a * std::max(-1.0, std::min({k - 3, 9 - k, 1.0}))) * 255;
+        };
+        return Color::RGBA{channel(0), channel(8), channel(4), alpha};
+    }
+
+    static std::optional<Color::RGBA> parseRgb(const std::string &value) {
+        auto components = parseComponents(value);
+        if (!components) {
+            return std::nullopt;
+        }
+        auto channel = [](const ColorComponent &component) {
+            // Percentages are relative to 255
+            return std::clamp(component.unit == "%" ? component.value * 2.55 : component.value,
+                              0.0, 255.0);
+        };
+        return Color::RGBA{channel((*components)[0]), channel((*components)[1]),
+                           channel((*components)[2]), alphaComponent(*components)};
+    }
+
+    static std::optional<Color::RGBA> parseHsl(const std::string &value) {
+        auto components = parseComponents(value);
+        if (!components) {
+            return std::nullopt;
+        }
+        return hslToRgb(hueComponent((*components)[0]), fractionComponent((*components)[1]),
+                        fractionComponent((*components)[2]), alphaComponent(*components));
+    }
+
+    static std::optional<Color::RGBA> parseHwb(const std::string &value) {
+        auto components = parseComponents(value);
+        if (!components) {
+            return std::nullopt;
+        }
+        double whiteness = fractionComponent((*components)[1]);
+        double blackness = fractionComponent((*components)[2]);
+        double alpha = alphaComponent(*components);
+        if (whiteness + blackness >= 1) {
+            double gray = whiteness / (whiteness + blackness) * 255;
+            return Color::RGBA{gray, gray, gray, alpha};
+        }
+        Color::RGBA color = hslToRgb(hueComponent((*components)[0]), 1, 0.5, alpha);
+        double scale = 1 - whiteness - blackness;
+        color.r = color.r * scale + whiteness * 255;
+        color.g = color.g * scale + whiteness * 255;
+        color.b = color.b * scale + whiteness * 255;
+        return color;
+    }
+
+    std::optional<Color::RGBA> Color::parse(const std::string &value) {
+        if (value.size() > 1 && value[0] == '#') {
+            return parseHex(value);
+        }
+        if (value.rfind("rgb(", 0) == 0 || value.rfind("rgba(", 0) == 0) {
+            return parseRgb(value);
+        }
+        if (value.rfind("hsl(", 0) == 0 || value.rfind("hsla(", 0) == 0) {
+            return parseHsl(value);
+        }
+        if (value.rfind("hwb(", 0) == 0) {
+            return parseHwb(value);
+        }
+        if (value == "transparent") {
+            return RGBA{0, 0, 0, 0};
+        }
+
+        const auto &named = namedColors();
+        auto it = named.find(value);
+        if (it == named.end()) {
+            return std::nullopt;
+        }
+        return RGBA{static_cast<double>((it->second >> 16) & 0xff),
+                    static_cast<double>((it->second >> 8) & 0xff),
+                    static_cast<double>(it->second & 0xff),
+                    1};
+    }
+
+    Color::RGBA Color::mix(const RGBA &from, const RGBA &to, double progress) {
+        return RGBA{
+                from.r + (to.r - from.r) * progress,
+                from.g + (to.g - from.g) * progress,
+                from.b + (to.b - from.b) * progress,
+                from.a + (to.a - from.a) * progress};
+    }
+
+    std::string Color::toString(const RGBA &color) {
+        auto channel = [](double value) {
+            return std::to_string(std::lround(std::clamp(value, 0.0, 255.0)));
+        };
+        char alpha[16];
+        std::snprintf(alpha, sizeof(alpha), "%.3g", std::clamp(color.a, 0.0, 1.0));
+        return "rgba(" + channel(color.r) + ", " + channel(color.g) + ", " + channel(color.b) +
+               ", " + alpha + ")";
+    }
+
+    int32_t Color::toProcessed(const RGBA &color) {
+        auto channel = [](double value) {
+            return static_cast<uint32_t>(std::lround(std::clamp(value, 0.0, 255.0)));
+        };
+        uint32_t argb = (channel(color.a * 255) << 24) | (channel(color.r) << 16) |
+                        (channel(color.g) << 8) | channel(color.b);
+        // processColor results are cached as signed ints by ShadowTreeUpdateManager
+        return static_cast<int32_t>(argb);
+    }
+
+} // namespace margelo::nitro::cssnitro
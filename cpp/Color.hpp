@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace margelo::nitro::cssnitro {
+
+    class Color {
+    public:
+        // A color with 0-255 channels and a 0-1 alpha
+        struct RGBA {
+            double r = 0;
+            double g = 0;
+            double b = 0;
+            double a = 1;
+        };
+
+        /**
+         * Parse a CSS color: #rgb, #rgba, #rrggbb, #rrggbbaa, rgb(), rgba(), hsl(), hsla(),
+         * hwb(), a named color or transparent.
+         * @return std::nullopt for anything else, e.g. a platform color
+         */
+        static std::optional<RGBA> parse(const std::string &value);
+
+        // Interpolate each channel of two colors
+        static RGBA mix(const RGBA &from, const RGBA &to, double progress);
+
+        // Format as rgba(), with the channels rounded to integers
+        static std::string toString(const RGBA &color);
+
+        // The 32 bit ARGB integer React Native's processColor() produces for this color
+        static int32_t toProcessed(const RGBA &color);
+    };
+
+} // namespace margelo::nitro::cssnitro
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace margelo::nitro::cssnitro {
+
+    /**
+     * The component IDs behind the handles of registry command buffers. JS assigns the
+     * handles, reusing released ones, and defines each one once, so the table stays as large
+     * as the number of components mounted at once.
+     */
+    class ComponentHandles {
+    public:
+        // Bind a handle to a component ID, replacing what it was bound to
+        void define(size_t handle, std::string componentId) {
+            if (handle >= ids_.size()) {
+                ids_.resize(handle + 1);
+            }
+            if (!ids_[handle]) {
+                defined_++;
+            }
+            ids_[handle] = std::move(componentId);
+        }
+
+        void release(size_t handle) {
+            if (handle < ids_.size() && ids_[handle]) {
+                ids_[handle].reset();
+                defined_--;
+            }
+        }
+
+        // Returns the component ID bound to a handle, or nullptr if it isn't defined
+        const std::string *find(size_t handle) const {
+            if (handle >= ids_.size() || !ids_[handle]) return nullptr;
+            return &*ids_[handle];
+        }
+
+        // The number of defined handles
+        size_t size() const {
+            return defined_;
+        }
+
+    private:
+        std::vector<std::optional<std::string>> ids_;
+        size_t defined_ = 0;
+    };
+
+} // namespace margelo::nitro::cssnitro
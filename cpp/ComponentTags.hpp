@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace margelo::nitro::cssnitro {
+
+    /**
+     * The native view tag each component is linked to, and the way back. A native touch or
+     * focus handler only knows the view it was called for, the registry only knows
+     * components. Relinking a component, or linking a tag to another component, drops the
+     * previous pairing.
+     */
+    template<typename Tag>
+    class ComponentTags {
+    public:
+        void link(const std::string &componentId, Tag tag) {
+            unlink(componentId);
+            auto previous = components_.find(tag);
+            if (previous != components_.end()) {
+                tags_.erase(previous->second);
+            }
+            components_[tag] = componentId;
+            tags_[componentId] = tag;
+        }
+
+        void unlink(const std::string &componentId) {
+            auto it = tags_.find(componentId);
+            if (it == tags_.end()) return;
+            components_.erase(it->second);
+            tags_.erase(it);
+        }
+
+        // Returns the componentId linked to a tag, or nullptr if none is linked
+        const std::string *find(Tag tag) const {
+            auto it = components_.find(tag);
+            if (it == components_.end()) return nullptr;
+            return &it->second;
+        }
+
+        // Call fn with the componentId linked to a tag, returns false if none is linked
+        template<typename Fn>
+        bool forTag(Tag tag, Fn &&fn) const {
+            const std::string *componentId = find(tag);
+            if (componentId == nullptr) return false;
+            std::forward<Fn>(fn)(*componentId);
+            return true;
+        }
+
+        size_t size() const {
+            return tags_.size();
+        }
+
+    private:
+        std::unordered_map<Tag, std::string> components_;
+        std::unordered_map<std::string, Tag> tags_;
+    };
+
+} // namespace margelo::nitro::cssnitro
@@ -51,6 +51,13 @@ namespace reactnativecss {
 
         inline void dispose() noexcept { effect_.dispose(); }
 
+        // Force a recompute, for changes the compute function can't subscribe to.
+        // Queued when called inside a batch. No-op until the first read.
+        inline void invalidate() {
+            if (initialized_.load(std::memory_order_acquire))
+                effect_.run();
+        }
+
     private:
         template<class U>
         explicit Computed(ComputeFn cb, U &&initial)
@@ -77,7 +84,8 @@ namespace reactnativecss {
                 return;
             std::lock_guard<std::mutex> lk(init_mutex_);
             if (!initialized_.load(std::memory_order_relaxed)) {
-                const_cast<Effect &>(effect_).run();
+                // Compute now even inside a batch, the caller needs the value
+                const_cast<Effect &>(effect_).runImmediate();
                 initialized_.store(true, std::memory_order_release);
             }
         }
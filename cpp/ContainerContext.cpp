@@ -5,121 +5,244 @@
 
 #include "ContainerContext.hpp"
 
+#include <cmath>
+
 namespace margelo::nitro::cssnitro {
 
     // Static member initialization
     std::unordered_map<std::string, LayoutBounds> ContainerContext::_layoutMap;
     std::unordered_map<std::string, ScopeHierarchy> ContainerContext::_scopeMap;
+    std::unordered_map<ContainerKey, ResolvedContainer, ContainerKeyHash, ContainerKeyEqual> ContainerContext::_resolvedCache;
+    double ContainerContext::_layoutQuantum = 0.0;
 
-    std::optional<std::string> ContainerContext::findInScope(const std::string &containerScope,
-                                                             const std::optional<std::string> &name) {
-        // If no name provided, return the container scope directly
-        if (!name.has_value()) {
-            return containerScope;
-        }
-
-        // Check if the scope exists
+    const std::string *ContainerContext::walkScope(const std::string &containerScope,
+                                                   const std::string &name) {
         auto scopeIt = _scopeMap.find(containerScope);
-        if (scopeIt == _scopeMap.end()) {
-            return std::nullopt;
+
+        while (scopeIt != _scopeMap.end()) {
+            const ScopeHierarchy &hierarchy = scopeIt->second;
+
+            // Check if name exists in current scope
+            if (hierarchy.names.find(name) != hierarchy.names.end()) {
+                return &scopeIt->first;
+            }
+
+            // Not found and we've reached root
+            if (hierarchy.parent.empty() || hierarchy.parent == "root") {
+                break;
+            }
+
+            scopeIt = _scopeMap.find(hierarchy.parent);
         }
 
-        const ScopeHierarchy &hierarchy = scopeIt->second;
+        return nullptr;
+    }
+
+    const ResolvedContainer *ContainerContext::resolve(const std::string &containerScope,
+                                                       const std::optional<std::string> &name) {
+        static const std::string unnamed;
+        const std::string &nameKey = name.has_value() ? name.value() : unnamed;
 
-        // Check if name exists in current scope
-        if (hierarchy.names.find(name.value()) != hierarchy.names.end()) {
-            return containerScope;
+        auto cachedIt = _resolvedCache.find(ContainerKeyView(containerScope, nameKey));
+        if (cachedIt != _resolvedCache.end()) {
+            return &cachedIt->second;
         }
 
-        // If not found and parent is not "root", check parent scope
-        if (!hierarchy.parent.empty() && hierarchy.parent != "root") {
-            return findInScope(hierarchy.parent, name);
+        // If no name provided, the container scope is the container itself
+        const std::string *foundKey = name.has_value() ? walkScope(containerScope, name.value())
+                                                       : &containerScope;
+        if (foundKey == nullptr) {
+            return nullptr;
         }
 
-        // Not found and we've reached root
-        return std::nullopt;
+        // Create the bounds up front so the pointer stays valid and readers
+        // can subscribe before the first layout arrives
+        auto layoutIt = _layoutMap.try_emplace(*foundKey).first;
+        ResolvedContainer resolved{&layoutIt->first, &layoutIt->second};
+
+        return &_resolvedCache.emplace(ContainerKey{containerScope, nameKey}, resolved)
+                .first->second;
+    }
+
+    std::optional<std::string> ContainerContext::findInScope(const std::string &containerScope,
+                                                             const std::optional<std::string> &name) {
+        const ResolvedContainer *container = resolve(containerScope, name);
+        if (container == nullptr) {
+            return std::nullopt;
+        }
+        return *container->key;
     }
 
     void ContainerContext::setScope(const std::string &containerScope,
                                     const std::string &parent,
                                     const std::unordered_set<std::string> &names) {
+        auto it = _scopeMap.find(containerScope);
+        if (it != _scopeMap.end() && it->second.parent == parent && it->second.names == names) {
+            return;
+        }
+
         _scopeMap[containerScope] = ScopeHierarchy(parent, names);
+
+        // Any cached lookup may have walked through this scope
+        _resolvedCache.clear();
     }
 
-    std::optional<double> ContainerContext::getX(const std::string &containerScope,
-                                                 const std::optional<std::string> &name,
-                                                 reactnativecss::Effect::GetProxy &get) {
-        auto foundKey = findInScope(containerScope, name);
-        if (!foundKey.has_value()) {
-            return std::nullopt;
+    std::optional<double> ContainerContext::getDimension(const ResolvedContainer &container,
+                                                         LayoutDimension dimension,
+                                                         reactnativecss::Effect::GetProxy &get) {
+        LayoutBounds &bounds = *container.bounds;
+        auto &derived = bounds.dimensions[static_cast<size_t>(dimension)];
+
+        if (!derived) {
+            double LayoutRect::*field = nullptr;
+            switch (dimension) {
+                case LayoutDimension::X:
+                    field = &LayoutRect::x;
+                    break;
+                case LayoutDimension::Y:
+                    field = &LayoutRect::y;
+                    break;
+                case LayoutDimension::Width:
+                    field = &LayoutRect::width;
+                    break;
+                case LayoutDimension::Height:
+                    field = &LayoutRect::height;
+                    break;
+            }
+
+            derived = reactnativecss::Computed<std::optional<double>>::create(
+                    [layout = bounds.layout, field](const std::optional<double> &prev,
+                                                    reactnativecss::Effect::GetProxy &get)
+                            -> std::optional<double> {
+                        (void) prev;
+                        const LayoutRect &rect = get(*layout);
+                        if (!rect.measured) {
+                            return std::nullopt;
+                        }
+                        return rect.*field;
+                    },
+                    std::optional<double>());
         }
 
-        // Get layout bounds
-        auto it = _layoutMap.find(foundKey.value());
-        if (it == _layoutMap.end()) {
-            return std::nullopt;
-        }
+        // Track the derived node through the proxy, even before the first layout
+        return get(*derived);
+    }
+
+    std::optional<double> ContainerContext::getX(const ResolvedContainer &container,
+                                                 reactnativecss::Effect::GetProxy &get) {
+        return getDimension(container, LayoutDimension::X, get);
+    }
 
-        // Track the observable through the proxy
-        return get(*it->second.x);
+    std::optional<double> ContainerContext::getY(const ResolvedContainer &container,
+                                                 reactnativecss::Effect::GetProxy &get) {
+        return getDimension(container, LayoutDimension::Y, get);
     }
 
-    std::optional<double> ContainerContext::getY(const std::string &containerScope,
+    std::optional<double> ContainerContext::getWidth(const ResolvedContainer &container,
+                                                     reactnativecss::Effect::GetProxy &get) {
+        return getDimension(container, LayoutDimension::Width, get);
+    }
+
+    std::optional<double> ContainerContext::getHeight(const ResolvedContainer &container,
+                                                      reactnativecss::Effect::GetProxy &get) {
+        return getDimension(container, LayoutDimension::Height, get);
+    }
+
+    std::optional<double> ContainerContext::getX(const std::string &containerScope,
                                                  const std::optional<std::string> &name,
                                                  reactnativecss::Effect::GetProxy &get) {
-        auto foundKey = findInScope(containerScope, name);
-        if (!foundKey.has_value()) {
+        const ResolvedContainer *container = resolve(containerScope, name);
+        if (container == nullptr) {
             return std::nullopt;
         }
+        return getX(*container, get);
+    }
 
-        auto it = _layoutMap.find(foundKey.value());
-        if (it == _layoutMap.end()) {
+    std::optional<double> ContainerContext::getY(const std::string &containerScope,
+                                                 const std::optional<std::string> &name,
+                                                 reactnativecss::Effect::GetProxy &get) {
+        const ResolvedContainer *container = resolve(containerScope, name);
+        if (container == nullptr) {
             return std::nullopt;
         }
-
-        return get(*it->second.y);
+        return getY(*container, get);
     }
 
     std::optional<double> ContainerContext::getWidth(const std::string &containerScope,
                                                      const std::optional<std::string> &name,
                                                      reactnativecss::Effect::GetProxy &get) {
-        auto foundKey = findInScope(containerScope, name);
-        if (!foundKey.has_value()) {
-            return std::nullopt;
-        }
-
-        auto it = _layoutMap.find(foundKey.value());
-        if (it == _layoutMap.end()) {
+        const ResolvedContainer *container = resolve(containerScope, name);
+        if (container == nullptr) {
             return std::nullopt;
         }
-
-        return get(*it->second.width);
+        return getWidth(*container, get);
     }
 
     std::optional<double> ContainerContext::getHeight(const std::string &containerScope,
                                                       const std::optional<std::string> &name,
                                                       reactnativecss::Effect::GetProxy &get) {
-        auto foundKey = findInScope(containerScope, name);
-        if (!foundKey.has_value()) {
-            return std::nullopt;
-        }
-
-        auto it = _layoutMap.find(foundKey.value());
-        if (it == _layoutMap.end()) {
+        const ResolvedContainer *container = resolve(containerScope, name);
+        if (container == nullptr) {
             return std::nullopt;
         }
-
-        return get(*it->second.height);
+        return getHeight(*container, get);
     }
 
     void ContainerContext::setLayout(const std::string &key,
                                      double x, double y,
                                      double width, double height) {
+        auto quantize = [](double value) {
+            if (_layoutQuantum <= 0.0) {
+                return value;
+            }
+            return std::round(value / _layoutQuantum) * _layoutQuantum;
+        };
+
         LayoutBounds &bounds = _layoutMap[key];
-        bounds.x->set(x);
-        bounds.y->set(y);
-        bounds.width->set(width);
-        bounds.height->set(height);
+
+        // Batch so the derived dimension nodes settle before their dependents run
+        reactnativecss::Effect::batch([&]() {
+            bounds.layout->set(LayoutRect{quantize(x), quantize(y),
+                                          quantize(width), quantize(height), true});
+        });
+    }
+
+    void ContainerContext::setLayoutQuantum(double quantum) {
+        _layoutQuantum = quantum > 0.0 ? quantum : 0.0;
+    }
+
+    void ContainerContext::remove(const std::string &key) {
+        // Evict the lookups made from this scope and the ones that resolved to it, before
+        // the bounds they point at are erased
+        for (auto it = _resolvedCache.begin(); it != _resolvedCache.end();) {
+            if (it->first.scope == key || *it->second.key == key) {
+                it = _resolvedCache.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        auto layoutIt = _layoutMap.find(key);
+        if (layoutIt != _layoutMap.end()) {
+            // Readers subscribe to the derived dimensions, which are destroyed with the bounds.
+            // Reset them directly so readers re-resolve instead of keeping a stale value.
+            for (auto &derived: layoutIt->second.dimensions) {
+                if (derived) {
+                    derived->set(std::optional<double>());
+                }
+            }
+            _layoutMap.erase(layoutIt);
+        }
+
+        _scopeMap.erase(key);
+    }
+
+    size_t ContainerContext::size() {
+        return _layoutMap.size() + _scopeMap.size();
+    }
+
+    size_t ContainerContext::cacheSize() {
+        return _resolvedCache.size();
     }
 
 } // namespace margelo::nitro::cssnitro
@@ -5,28 +5,50 @@
 
 #pragma once
 
+#include <array>
+#include <cstddef>
 #include <unordered_map>
 #include <unordered_set>
 #include <string>
+#include <string_view>
 #include <memory>
 #include <optional>
 #include "Effect.hpp"
 #include "Observable.hpp"
+#include "Computed.hpp"
 
 namespace margelo::nitro::cssnitro {
 
+    // A single layout measurement. Updated as one value so a layout event
+    // notifies once, regardless of how many dimensions changed.
+    struct LayoutRect {
+        double x = 0.0;
+        double y = 0.0;
+        double width = 0.0;
+        double height = 0.0;
+        // False until the first setLayout() for this key
+        bool measured = false;
+
+        bool operator==(const LayoutRect &other) const = default;
+    };
+
+    enum class LayoutDimension : size_t {
+        X = 0,
+        Y,
+        Width,
+        Height,
+    };
+
     // Layout bounds structure
     struct LayoutBounds {
-        std::shared_ptr<reactnativecss::Observable<double>> x;
-        std::shared_ptr<reactnativecss::Observable<double>> y;
-        std::shared_ptr<reactnativecss::Observable<double>> width;
-        std::shared_ptr<reactnativecss::Observable<double>> height;
+        std::shared_ptr<reactnativecss::Observable<LayoutRect>> layout;
+        // Derived per-dimension nodes, created on first read. Consumers subscribe to
+        // these so they only wake when the dimension they use changes.
+        std::array<std::shared_ptr<reactnativecss::Computed<std::optional<double>>>, 4> dimensions;
 
         LayoutBounds()
-                : x(reactnativecss::Observable<double>::create(0.0)),
-                  y(reactnativecss::Observable<double>::create(0.0)),
-                  width(reactnativecss::Observable<double>::create(0.0)),
-                  height(reactnativecss::Observable<double>::create(0.0)) {}
+                : layout(reactnativecss::Observable<LayoutRect>::create(LayoutRect{})),
+                  dimensions() {}
     };
 
     // Scope hierarchy structure
@@ -40,6 +62,48 @@ namespace margelo::nitro::cssnitro {
                 : parent(std::move(p)), names(std::move(n)) {}
     };
 
+    // A resolved (scope, name) lookup. Both pointers reference nodes inside
+    // ContainerContext's maps, which are stable for the lifetime of the entry.
+    struct ResolvedContainer {
+        const std::string *key = nullptr;
+        LayoutBounds *bounds = nullptr;
+    };
+
+    // The (scope, name) a resolved container is cached under. Unnamed lookups use the
+    // empty name.
+    struct ContainerKey {
+        std::string scope;
+        std::string name;
+    };
+
+    // Lookups hash and compare views, so a cache hit doesn't copy either string
+    struct ContainerKeyView {
+        std::string_view scope;
+        std::string_view name;
+
+        ContainerKeyView(std::string_view s, std::string_view n) : scope(s), name(n) {}
+
+        ContainerKeyView(const ContainerKey &key) : scope(key.scope), name(key.name) {}
+    };
+
+    struct ContainerKeyHash {
+        using is_transparent = void;
+
+        size_t operator()(ContainerKeyView key) const noexcept {
+            size_t seed = std::hash<std::string_view>{}(key.scope);
+            return seed ^ (std::hash<std::string_view>{}(key.name) + 0x9e3779b9 + (seed << 6) +
+                           (seed >> 2));
+        }
+    };
+
+    struct ContainerKeyEqual {
+        using is_transparent = void;
+
+        bool operator()(ContainerKeyView a, ContainerKeyView b) const noexcept {
+            return a.scope == b.scope && a.name == b.name;
+        }
+    };
+
     /**
      * ContainerContext manages layout bounds and scope hierarchies for containers
      */
@@ -48,7 +112,29 @@ namespace margelo::nitro::cssnitro {
         static std::unordered_map<std::string, LayoutBounds> _layoutMap;
         static std::unordered_map<std::string, ScopeHierarchy> _scopeMap;
 
+        // Cache of successful lookups, keyed by (containerScope, name). Lookups that
+        // don't resolve are not cached. Cleared whenever a scope hierarchy changes,
+        // removing a container evicts the entries of its scope and the ones resolved to it.
+        static std::unordered_map<ContainerKey, ResolvedContainer, ContainerKeyHash, ContainerKeyEqual> _resolvedCache;
+
+        // Layout values are rounded to this step before they are stored (0 disables)
+        static double _layoutQuantum;
+
+        static const std::string *
+        walkScope(const std::string &containerScope, const std::string &name);
+
+        static std::optional<double> getDimension(const ResolvedContainer &container,
+                                                  LayoutDimension dimension,
+                                                  reactnativecss::Effect::GetProxy &get);
+
     public:
+        /**
+         * Resolve a container by scope and optional name, walking the scope hierarchy
+         * on the first lookup only. Returns nullptr if no container matches.
+         */
+        static const ResolvedContainer *
+        resolve(const std::string &containerScope, const std::optional<std::string> &name);
+
         // Helper to find a name in scope hierarchy
         static std::optional<std::string>
         findInScope(const std::string &containerScope, const std::optional<std::string> &name);
@@ -92,8 +178,49 @@ namespace margelo::nitro::cssnitro {
                                                const std::optional<std::string> &name,
                                                reactnativecss::Effect::GetProxy &get);
 
+        /**
+         * Get the layout coordinates for an already resolved container
+         */
+        static std::optional<double> getX(const ResolvedContainer &container,
+                                          reactnativecss::Effect::GetProxy &get);
+
+        static std::optional<double> getY(const ResolvedContainer &container,
+                                          reactnativecss::Effect::GetProxy &get);
+
+        static std::optional<double> getWidth(const ResolvedContainer &container,
+                                              reactnativecss::Effect::GetProxy &get);
+
+        static std::optional<double> getHeight(const ResolvedContainer &container,
+                                               reactnativecss::Effect::GetProxy &get);
+
+        /**
+         * Update the layout of a container/element. All four values are applied as a
+         * single record, so dependents recompute at most once per call.
+         */
         static void
         setLayout(const std::string &key, double x, double y, double width, double height);
+
+        /**
+         * Set the step layout values are rounded to. Changes smaller than the step
+         * (e.g. sub-pixel jitter) will not notify dependents. 0 disables rounding.
+         */
+        static void setLayoutQuantum(double quantum);
+
+        /**
+         * Remove the layout and scope hierarchy of a container/element. Readers of its
+         * layout are notified that it is no longer measured.
+         */
+        static void remove(const std::string &key);
+
+        /**
+         * The number of layouts and scopes currently held.
+         */
+        static size_t size();
+
+        /**
+         * The number of cached (scope, name) lookups.
+         */
+        static size_t cacheSize();
     };
 
 } // namespace margelo::nitro::cssnitro
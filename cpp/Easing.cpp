@@ -0,0 +1,148 @@
+#include "Easing.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <variant>
+
+namespace margelo::nitro::cssnitro {
+
+    using AnyArray = ::margelo::nitro::AnyArray;
+    using AnyValue = ::margelo::nitro::AnyValue;
+
+    double Easing::linear(double progress) {
+        return progress;
+    }
+
+    Easing::Function Easing::cubicBezier(double x1, double y1, double x2, double y2) {
+        // Polynomial coefficients of the curve, with P0 = (0, 0) and P3 = (1, 1)
+        const double cx = 3 * x1;
+        const double bx = 3 * (x2 - x1) - cx;
+        const double ax = 1 - cx - bx;
+        const double cy = 3 * y1;
+        const double by = 3 * (y2 - y1) - cy;
+        const double ay = 1 - cy - by;
+
+        return [=](double progress) {
+            if (progress <= 0 || progress >= 1) {
+                return progress;
+            }
+
+            auto sampleX = [&](double t) { return ((ax * t + bx) * t + cx) * t; };
+            auto sampleDerivativeX = [&](double t) { return (3 * ax * t + 2 * bx) * t + cx; };
+
+            // Find t for x = progress, Newton-Raphson first and bisection if it doesn't converge
+            double t = progress;
+            bool solved = false;
+            for (int i = 0; i < 8; i++) {
+                double error = sampleX(t) - progress;
+                if (std::fabs(error) < 1e-7) {
+                    solved = true;
+                    break;
+                }
+                double derivative = sampleDerivativeX(t);
+                if (std::fabs(derivative) < 1e-6) {
+                    break;
+                }
+                t -= error / derivative;
+            }
+
+            if (!solved) {
+                double low = 0;
+                double high = 1;
+                t = progress;
+                while (low < high) {
+                    double x = sampleX(t);
+                    if (std::fabs(x - progress) < 1e-7) {
+                        break;
+                    }
+                    if (progress > x) {
+                        low = t;
+                    } else {
+                        high = t;
+                    }
+                    double mid = (high - low) / 2 + low;
+                    if (mid == t) {
+                        break;
+                    }
+                    t = mid;
+                }
+            }
+
+            return ((ay * t + by) * t + cy) * t;
+        };
+    }
+
+    Easing::Function Easing::steps(int count, const std::string &position) {
+        count = std::max(count, 1);
+        const bool jumpStart = position == "jump-start" || position == "start" ||
+                               position == "jump-both";
+        int jumps = count;
+        if (position == "jump-none") {
+            jumps = std::max(count - 1, 1);
+        } else if (position == "jump-both") {
+            jumps = count + 1;
+        }
+
+        return [count, jumpStart, jumps](double progress) {
+            double step = std::floor(progress * count);
+            if (jumpStart) {
+                step += 1;
+            }
+            if (progress >= 0 && step < 0) {
+                step = 0;
+            }
+            if (progress <= 1 && step > jumps) {
+                step = jumps;
+            }
+            return step / jumps;
+        };
+    }
+
+    Easing::Function Easing::parse(const AnyValue &timingFunction) {
+        if (std::holds_alternative<std::string>(timingFunction)) {
+            const auto &keyword = std::get<std::string>(timingFunction);
+            if (keyword == "linear") {
+                return linear;
+            } else if (keyword == "ease-in") {
+                return cubicBezier(0.42, 0, 1, 1);
+            } else if (keyword == "ease-out") {
+                return cubicBezier(0, 0, 0.58, 1);
+            } else if (keyword == "ease-in-out") {
+                return cubicBezier(0.42, 0, 0.58, 1);
+            } else if (keyword == "step-start") {
+                return steps(1, "jump-start");
+            } else if (keyword == "step-end") {
+                return steps(1, "jump-end");
+            }
+            return cubicBezier(0.25, 0.1, 0.25, 1);
+        }
+
+        if (std::holds_alternative<AnyArray>(timingFunction)) {
+            const auto &arr = std::get<AnyArray>(timingFunction);
+            if (arr.size() >= 3 && std::holds_alternative<std::string>(arr[0]) &&
+                std::get<std::string>(arr[0]) == "fn" &&
+                std::holds_alternative<std::string>(arr[1])) {
+                const auto &name = std::get<std::string>(arr[1]);
+
+                if (name == "cubicBezier" && arr.size() == 6 &&
+                    std::all_of(arr.begin() + 2, arr.end(), [](const AnyValue &value) {
+                        return std::holds_alternative<double>(value);
+                    })) {
+                    return cubicBezier(std::get<double>(arr[2]), std::get<double>(arr[3]),
+                                       std::get<double>(arr[4]), std::get<double>(arr[5]));
+                }
+
+                if (name == "steps" && std::holds_alternative<double>(arr[2])) {
+                    std::string position = "jump-end";
+                    if (arr.size() >= 4 && std::holds_alternative<std::string>(arr[3])) {
+                        position = std::get<std::string>(arr[3]);
+                    }
+                    return steps(static_cast<int>(std::get<double>(arr[2])), position);
+                }
+            }
+        }
+
+        return cubicBezier(0.25, 0.1, 0.25, 1);
+    }
+
+} // namespace margelo::nitro::cssnitro
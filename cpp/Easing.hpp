@@ -0,0 +1,30 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include <NitroModules/AnyMap.hpp>
+
+namespace margelo::nitro::cssnitro {
+
+    class Easing {
+    public:
+        // Maps the linear progress of a keyframe interval (0-1) to its eased progress
+        using Function = std::function<double(double)>;
+
+        static double linear(double progress);
+
+        /**
+         * Build the easing for a compiled timing function: a keyword ("ease", "ease-in", ...),
+         * ["fn", "cubicBezier", x1, y1, x2, y2] or ["fn", "steps", count, position?].
+         * Anything else falls back to "ease", the CSS initial value.
+         */
+        static Function parse(const margelo::nitro::AnyValue &timingFunction);
+
+        static Function cubicBezier(double x1, double y1, double x2, double y2);
+
+        // position is one of jump-start/start, jump-end/end, jump-none, jump-both
+        static Function steps(int count, const std::string &position);
+    };
+
+} // namespace margelo::nitro::cssnitro
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
 #include <functional>
 #include <memory>
 #include <mutex>
@@ -48,7 +50,13 @@ namespace reactnativecss {
 
         Effect &operator=(Effect &&) = delete;
 
-        ~Effect() { dispose(); }
+        ~Effect() {
+            // Drop any queued run so a pending batch never touches a dead effect
+            if (s_pendingSet.erase(this) > 0) {
+                std::replace(s_pending.begin(), s_pending.end(), this, static_cast<Effect *>(nullptr));
+            }
+            dispose();
+        }
 
         // Register a remover to undo a single subscription this effect created
         void subscribe(std::function<void()> remover) {
@@ -104,6 +112,9 @@ namespace reactnativecss {
         }
 
     private:
+        template<class T>
+        friend class Computed;
+
         Callback callback_;
         mutable std::mutex mutex_;
         std::vector<std::function<void()>> removers_;
@@ -123,14 +134,27 @@ namespace reactnativecss {
         static inline thread_local std::unordered_set<Effect *> s_pendingSet{};
 
         static void flushPending() {
-            // Swap out current queue to allow re-entrancy
-            std::vector<Effect *> queue;
-            queue.swap(s_pending);
-            s_pendingSet.clear();
-            for (Effect *e: queue) {
-                if (e)
+            // Keep batching while flushing: effects woken by the flush (e.g. the
+            // subscribers of a recomputed Computed) are appended to the queue and
+            // run once, rather than immediately for every notification.
+            ++s_batchDepth;
+            try {
+                for (size_t i = 0; i < s_pending.size(); ++i) {
+                    Effect *e = s_pending[i];
+                    if (!e)
+                        continue;
+                    // Allow the effect to be queued again if it is woken after it ran
+                    s_pendingSet.erase(e);
                     e->runImmediate();
+                }
+            } catch (...) {
+                s_pending.clear();
+                s_pendingSet.clear();
+                --s_batchDepth;
+                throw;
             }
+            s_pending.clear();
+            --s_batchDepth;
         }
     };
 
@@ -23,6 +23,27 @@ namespace reactnativecss {
             return inst;
         }
 
+        static std::shared_ptr<reactnativecss::Observable<double>> &remRef() {
+            static auto inst = reactnativecss::Observable<double>::create(14.0);
+            return inst;
+        }
+
+        static std::shared_ptr<reactnativecss::Computed<double>> &vwRef() {
+            static auto inst = reactnativecss::Computed<double>::create(
+                    [](const double &, reactnativecss::Effect::GetProxy &get) {
+                        return get(*widthRef()) / 100.0;
+                    }, 0.0);
+            return inst;
+        }
+
+        static std::shared_ptr<reactnativecss::Computed<double>> &vhRef() {
+            static auto inst = reactnativecss::Computed<double>::create(
+                    [](const double &, reactnativecss::Effect::GetProxy &get) {
+                        return get(*heightRef()) / 100.0;
+                    }, 0.0);
+            return inst;
+        }
+
         reactnativecss::Observable<double> &windowWidth() { return *widthRef(); }
 
         reactnativecss::Observable<double> &windowHeight() { return *heightRef(); }
@@ -31,6 +52,12 @@ namespace reactnativecss {
 
         reactnativecss::Observable<double> &windowFontScale() { return *fontScaleRef(); }
 
+        reactnativecss::Observable<double> &rem() { return *remRef(); }
+
+        reactnativecss::Computed<double> &vw() { return *vwRef(); }
+
+        reactnativecss::Computed<double> &vh() { return *vhRef(); }
+
         void setWindowDimensions(double width, double height, double scale, double fontScale) {
             widthRef()->set(width);
             heightRef()->set(height);
@@ -38,6 +65,10 @@ namespace reactnativecss {
             fontScaleRef()->set(fontScale);
         }
 
+        void setRem(double value) {
+            remRef()->set(value);
+        }
+
     } // namespace env
 } // namespace reactnativecss
 
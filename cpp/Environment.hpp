@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Observable.hpp"
+#include "Computed.hpp"
 
 namespace reactnativecss {
     namespace env {
@@ -16,9 +17,19 @@ namespace reactnativecss {
 
         reactnativecss::Observable<double> &windowFontScale();
 
+// The root font size (rem) of the current stylesheet, defaults to 14.
+        reactnativecss::Observable<double> &rem();
+
+// Precomputed unit multipliers: the size of 1vw / 1vh in dp.
+        reactnativecss::Computed<double> &vw();
+
+        reactnativecss::Computed<double> &vh();
+
 // Convenience API to update all four metrics in one shot.
         void setWindowDimensions(double width, double height, double scale, double fontScale);
 
+        void setRem(double value);
+
     } // namespace env
 } // namespace reactnativecss
 
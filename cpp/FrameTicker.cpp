@@ -0,0 +1,66 @@
+#include "FrameTicker.hpp"
+
+#include <utility>
+
+namespace margelo::nitro::cssnitro {
+
+    FrameTicker::FrameTicker(std::chrono::milliseconds interval, Frame frame)
+            : interval_(interval), frame_(std::move(frame)) {}
+
+    FrameTicker::~FrameTicker() {
+        stop();
+    }
+
+    void FrameTicker::start() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) return;
+            ++starts_;
+            ticking_ = true;
+            if (!thread_.joinable()) {
+                thread_ = std::thread([this] { run(); });
+            }
+        }
+        wake_.notify_all();
+    }
+
+    void FrameTicker::stop() {
+        std::thread thread;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+            ticking_ = false;
+            if (thread_.get_id() == std::this_thread::get_id()) return;
+            thread = std::move(thread_);
+        }
+        wake_.notify_all();
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+    bool FrameTicker::ticking() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return ticking_;
+    }
+
+    void FrameTicker::run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            wake_.wait(lock, [this] { return ticking_ || stopping_; });
+            if (stopping_) return;
+
+            // Only a stop wakes the thread early
+            if (wake_.wait_for(lock, interval_, [this] { return stopping_; })) return;
+
+            const uint64_t starts = starts_;
+            lock.unlock();
+            const bool more = frame_();
+            lock.lock();
+            if (!more && starts == starts_) {
+                ticking_ = false;
+            }
+        }
+    }
+
+} // namespace margelo::nitro::cssnitro
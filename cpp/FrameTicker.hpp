@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace margelo::nitro::cssnitro {
+
+    /**
+     * A native frame clock on a thread it owns. Once started it calls the frame roughly
+     * once per interval until a frame reports it ran out of work, then idles until the
+     * next start. The thread is joined when the ticker is stopped or destroyed, so a
+     * frame never outlives the state it reads.
+     */
+    class FrameTicker {
+    public:
+        // Returns whether there is more work, i.e. whether to keep ticking
+        using Frame = std::function<bool()>;
+
+        FrameTicker(std::chrono::milliseconds interval, Frame frame);
+
+        ~FrameTicker();
+
+        FrameTicker(const FrameTicker &) = delete;
+
+        FrameTicker &operator=(const FrameTicker &) = delete;
+
+        // Start ticking, a no-op while ticking. Wins over a frame finishing concurrently.
+        void start();
+
+        // Stop for good and join the thread, from a frame the thread is joined on destruction
+        void stop();
+
+        bool ticking() const;
+
+    private:
+        const std::chrono::milliseconds interval_;
+        const Frame frame_;
+
+        mutable std::mutex mutex_;
+        std::condition_variable wake_;
+        bool ticking_ = false;
+        bool stopping_ = false;
+        // Counts starts, so a start during a frame isn't undone by that frame's result
+        uint64_t starts_ = 0;
+        std::thread thread_;
+
+        void run();
+    };
+
+} // namespace margelo::nitro::cssnitro
@@ -6,10 +6,18 @@
 #include "StyledComputedFactory.hpp"
 #include "Environment.hpp"
 #include "VariableContext.hpp"
+#include "StyleFunction.hpp"
 #include "PseudoClasses.hpp"
 #include "JSLogger.hpp"
 #include "Animations.hpp"
-
+#include "AnimationDriver.hpp"
+#include "RerenderQueue.hpp"
+#include "RegistryCommands.hpp"
+#include "FrameTicker.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <regex>
 #include <string>
 #include <variant>
@@ -17,7 +25,9 @@
 #include <optional>
 #include <unordered_map>
 #include <mutex>
+#include <thread>
 #include <folly/dynamic.h>
+#include <NitroModules/Dispatcher.hpp>
 #include <react/renderer/core/ReactPrimitives.h>
 
 
@@ -28,9 +38,25 @@ namespace margelo::nitro::cssnitro {
     // Initialize static members
     std::unique_ptr<ShadowTreeUpdateManager> HybridStyleRegistry::shadowUpdates_ =
             std::make_unique<ShadowTreeUpdateManager>();
+    std::unique_ptr<AnimationDriver> HybridStyleRegistry::animationDriver_ = []() {
+        auto driver = std::make_unique<AnimationDriver>();
+        driver->setOnActive(&HybridStyleRegistry::startAnimationTimer);
+        return driver;
+    }();
+    std::unique_ptr<RerenderQueue> HybridStyleRegistry::rerenders_ =
+            std::make_unique<RerenderQueue>();
     std::unordered_map<std::string, HybridStyleRegistry::ComputedEntry> HybridStyleRegistry::computedMap_;
+    ScopeUsers HybridStyleRegistry::scopeUsers_{&HybridStyleRegistry::freeScope};
     std::unordered_map<std::string, std::shared_ptr<reactnativecss::Observable<std::vector<HybridStyleRule>>>> HybridStyleRegistry::styleRuleMap_;
     std::atomic<uint64_t> HybridStyleRegistry::nextStyleRuleId_{1};
+    std::shared_ptr<Dispatcher> HybridStyleRegistry::jsDispatcher_;
+    std::thread::id HybridStyleRegistry::jsThreadId_;
+    ComponentHandles HybridStyleRegistry::componentHandles_;
+    std::recursive_mutex HybridStyleRegistry::mutex_;
+    // Defined after everything its frames read, so it is joined before they are destroyed.
+    // Roughly one frame at 60Hz.
+    FrameTicker HybridStyleRegistry::animationTicker_{std::chrono::milliseconds(16),
+                                                      &HybridStyleRegistry::animationFrame};
 
     // Constructor, Destructor, and Method Implementations
     HybridStyleRegistry::HybridStyleRegistry() : HybridObject("HybridStyleRegistry") {}
@@ -39,6 +65,7 @@ namespace margelo::nitro::cssnitro {
 
     void HybridStyleRegistry::setClassname(const std::string &className,
                                            const std::vector<HybridStyleRule> &styleRules) {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
         // Create a copy of the style rules to modify them
         auto rulesWithIds = styleRules;
 
@@ -47,6 +74,28 @@ namespace margelo::nitro::cssnitro {
             if (!rule.id.has_value()) {
                 rule.id = std::to_string(nextStyleRuleId_++);
             }
+
+            // Fold constant calc() expressions once, so only dynamic leaves are resolved later
+            if (rule.d.has_value()) {
+                rule.d = StyleFunction::foldConstants(rule.d.value());
+            }
+            if (rule.p.has_value()) {
+                rule.p = StyleFunction::foldConstants(rule.p.value());
+            }
+            if (rule.v.has_value()) {
+                rule.v = StyleFunction::foldConstants(rule.v.value());
+            }
+
+            // Convert the static values now, so updates don't parse colors or call into JS
+            if (rule.d.has_value()) {
+                shadowUpdates_->precomputeFragments(rule.d.value());
+            }
+            if (rule.p.has_value()) {
+                shadowUpdates_->precomputeColors(rule.p.value());
+            }
+            if (rule.v.has_value()) {
+                precomputeVariableColors(rule.v.value());
+            }
         }
 
         // Reverse the style rules, this way later on we can bail early if values are already set
@@ -64,8 +113,14 @@ namespace margelo::nitro::cssnitro {
     }
 
     void HybridStyleRegistry::addStyleSheet(const HybridStyleSheet &stylesheet) {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
         // Create an Effect batch to process all style updates together
         reactnativecss::Effect::batch([this, &stylesheet]() {
+            // The root font size used to resolve rem units
+            if (stylesheet.r.has_value()) {
+                reactnativecss::env::setRem(stylesheet.r.value());
+            }
+
             // If the key "s" exists, loop over every entry
             if (stylesheet.s.has_value()) {
                 const auto &stylesMap = stylesheet.s.value();
@@ -79,6 +134,9 @@ namespace margelo::nitro::cssnitro {
     }
 
     void HybridStyleRegistry::setRootVariables(const std::shared_ptr<AnyMap> &variables) {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+        precomputeVariableColors(variables);
 
         // Loop over all entries in the AnyMap
         for (const auto &entry: variables->getMap()) {
@@ -91,6 +149,9 @@ namespace margelo::nitro::cssnitro {
     }
 
     void HybridStyleRegistry::setUniversalVariables(const std::shared_ptr<AnyMap> &variables) {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+        precomputeVariableColors(variables);
 
         // Loop over all entries in the AnyMap
         for (const auto &entry: variables->getMap()) {
@@ -106,6 +167,7 @@ namespace margelo::nitro::cssnitro {
                                                       const std::string &classNames,
                                                       const std::string &variableScope,
                                                       const std::string &containerScope) {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
         Declarations declarations;
         declarations.variableScope = variableScope;
 
@@ -114,6 +176,8 @@ namespace margelo::nitro::cssnitro {
         std::sregex_token_iterator end;
 
         std::vector<std::tuple<std::string, AttributeQuery>> attributeQueriesVec;
+        bool isContainer = false;
+        std::unordered_set<std::string> containerNames;
 
         for (; tokenIt != end; ++tokenIt) {
             const std::string className = tokenIt->str();
@@ -140,6 +204,12 @@ namespace margelo::nitro::cssnitro {
                     hasVars = true;
                 }
 
+                // Check for container names, an unnamed container has none
+                if (sr.c.has_value()) {
+                    isContainer = true;
+                    containerNames.insert(sr.c->begin(), sr.c->end());
+                }
+
                 // Check for pseudo-classes
                 if (sr.pq.has_value()) {
                     const auto &pseudoClass = sr.pq.value();
@@ -165,6 +235,13 @@ namespace margelo::nitro::cssnitro {
             }
         }
 
+        // A container is the scope of its descendants, their queries resolve through it to
+        // the scope it was rendered in. Its layout is stored under its componentId.
+        if (isContainer) {
+            ContainerContext::setScope(componentId, containerScope, containerNames);
+            declarations.containerScope = componentId;
+        }
+
         // Set attributeQueries if we found any
         if (!attributeQueriesVec.empty()) {
             declarations.attributeQueries = std::move(attributeQueriesVec);
@@ -180,6 +257,7 @@ namespace margelo::nitro::cssnitro {
                                            const std::string &variableScope,
                                            const std::string &containerScope,
                                            const std::vector<std::string> &validAttributeQueries) {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
         // Check if an entry exists for this component
         auto existing = computedMap_.find(componentId);
 
@@ -201,22 +279,39 @@ namespace margelo::nitro::cssnitro {
 
         if (shouldRecreate) {
             // Dispose old computed if it exists
-            if (existing != computedMap_.end() && existing->second.computed) {
-                existing->second.computed->dispose();
+            if (existing != computedMap_.end()) {
+                disposeEntry(existing->second);
+            }
+
+            // Retain the new scopes before releasing the old ones, so a shared scope survives
+            scopeUsers_.retain(variableScope);
+            scopeUsers_.retain(containerScope);
+            if (existing != computedMap_.end()) {
+                scopeUsers_.release(existing->second.variableScope);
+                scopeUsers_.release(existing->second.containerScope);
             }
 
+            // Match the rules first, this commits the inline variables before styles resolve
+            auto matchedRules = reactnativecss::Observable<MatchedRules>::create(nullptr);
+            auto rulesEffect = ::margelo::nitro::cssnitro::makeMatchedRulesEffect(
+                    styleRuleMap_, classNames, componentId, variableScope, containerScope,
+                    validAttributeQueries, matchedRules);
+            rulesEffect->run();
+
             // Build new computed Styled via factory
-            computed = ::margelo::nitro::cssnitro::makeStyledComputed(styleRuleMap_, classNames,
+            computed = ::margelo::nitro::cssnitro::makeStyledComputed(matchedRules,
                                                                       componentId,
                                                                       rerender,
+                                                                      *rerenders_,
                                                                       *shadowUpdates_,
-                                                                      variableScope,
-                                                                      containerScope,
-                                                                      validAttributeQueries);
+                                                                      *animationDriver_,
+                                                                      variableScope);
 
             // Store the new computed with its parameters
             computedMap_[componentId] = ComputedEntry{
                     computed,
+                    rulesEffect,
+                    matchedRules,
                     classNames,
                     variableScope,
                     containerScope
@@ -231,46 +326,235 @@ namespace margelo::nitro::cssnitro {
 
         // If nullptr, return empty Styled{}
         if (styledPtr == nullptr) {
+            shadowUpdates_->markRendered(componentId, nullptr, nullptr);
             return Styled{};
         }
 
+        // The view is created with this style, later updates are diffed against it
+        shadowUpdates_->markRendered(componentId, styledPtr->style.value_or(nullptr),
+                                     styledPtr->importantStyle.value_or(nullptr));
+
         // Otherwise dereference and return the value
         return *styledPtr;
     }
 
     void HybridStyleRegistry::deregisterComponent(const std::string &componentId) {
-        auto it = computedMap_.find(componentId);
-        if (it != computedMap_.end()) {
-            if (it->second.computed) {
-                it->second.computed->dispose();
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+        reactnativecss::Effect::batch([&]() {
+            auto it = computedMap_.find(componentId);
+            if (it != computedMap_.end()) {
+                disposeEntry(it->second);
+                scopeUsers_.release(it->second.variableScope);
+                scopeUsers_.release(it->second.containerScope);
+                computedMap_.erase(it);
+            }
+
+            // State keyed by the component itself
+            PseudoClasses::remove(componentId);
+            shadowUpdates_->removeComponent(componentId);
+            animationDriver_->stop(componentId);
+            rerenders_->cancel(componentId);
+
+            // The component's own scope may still be read by its children
+            scopeUsers_.orphan(componentId);
+        });
+    }
+
+    void HybridStyleRegistry::disposeEntry(ComputedEntry &entry) {
+        if (entry.rulesEffect) {
+            entry.rulesEffect->dispose();
+        }
+        if (entry.computed) {
+            entry.computed->dispose();
+
+            // The computed owns its last Styled value, it was initialized at registration
+            delete entry.computed->get();
+            entry.computed->set(static_cast<Styled *>(nullptr));
+        }
+    }
+
+    void HybridStyleRegistry::freeScope(const std::string &scope) {
+        VariableContext::deleteContext(scope);
+        ContainerContext::remove(scope);
+        reactnativecss::animations::deleteScope(scope);
+    }
+
+    void HybridStyleRegistry::precomputeVariableColors(const std::shared_ptr<AnyMap> &variables) {
+        if (!variables) {
+            return;
+        }
+        // Variable names don't say whether they hold a color, any color string is converted.
+        // Top level values are lists of media-conditioned candidates.
+        std::function<void(const AnyValue &)> visit = [&](const AnyValue &value) {
+            if (std::holds_alternative<std::string>(value)) {
+                shadowUpdates_->precomputeColor(std::get<std::string>(value));
+            } else if (std::holds_alternative<AnyArray>(value)) {
+                for (const auto &item: std::get<AnyArray>(value)) {
+                    visit(item);
+                }
             }
-            computedMap_.erase(it);
+        };
+        for (const auto &entry: variables->getMap()) {
+            visit(entry.second);
+        }
+    }
+
+    void HybridStyleRegistry::startAnimationTimer() {
+        // Called by the driver under mutex_
+        animationTicker_.start();
+    }
+
+    bool HybridStyleRegistry::animationFrame() {
+        // On the ticker's thread. Frames are staged and committed here, like native state
+        // changes, so a busy JS thread doesn't hold animations back. Frames of components
+        // that aren't linked yet are parked until they are.
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        if (!animationDriver_->active()) {
+            return false;
         }
+        applyAnimationFrame();
+        return true;
+    }
+
+    void HybridStyleRegistry::applyAnimationFrame() {
+        // Frames are sampled at the clock's time, so a late frame doesn't slow the
+        // animation down
+        auto frames = animationDriver_->tick();
+        reactnativecss::Effect::batch([&]() {
+            for (const auto &frame: frames) {
+                auto styleMap = AnyMap::make(frame.second.size());
+                for (const auto &entry: frame.second) {
+                    styleMap->setAny(entry.first, entry.second);
+                }
+                shadowUpdates_->addUpdates(frame.first, styleMap);
+            }
+        });
+    }
+
+    HybridStyleRegistry::LiveStateCounts HybridStyleRegistry::getLiveStateCounts() {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        return LiveStateCounts{
+                computedMap_.size(),
+                scopeUsers_.size(),
+                PseudoClasses::size(),
+                ContainerContext::size(),
+                VariableContext::size(),
+                reactnativecss::animations::scopeCount(),
+                animationDriver_->size(),
+                rerenders_->size(),
+                componentHandles_.size(),
+        };
     }
 
     void HybridStyleRegistry::updateComponentState(const std::string &componentId,
                                                    PseudoClassType type, bool value) {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
         PseudoClasses::set(componentId, type, value);
     }
 
     void HybridStyleRegistry::updateComponentLayout(const std::string &componentId,
                                                     const margelo::nitro::cssnitro::LayoutRectangle &value) {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
 
         ContainerContext::setLayout(componentId, value.x, value.y, value.width, value.height);
     }
 
+    void HybridStyleRegistry::updateComponentLayouts(const std::vector<std::string> &componentIds,
+                                                     const std::shared_ptr<ArrayBuffer> &layouts) {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        if (!layouts) {
+            return;
+        }
+
+        // Each record is [x, y, width, height] as doubles
+        constexpr size_t recordSize = 4 * sizeof(double);
+        const size_t count = std::min(componentIds.size(), layouts->size() / recordSize);
+        const uint8_t *data = layouts->data();
+
+        // One batch for every record, so container queries are re-evaluated once
+        reactnativecss::Effect::batch([&]() {
+            for (size_t i = 0; i < count; i++) {
+                double record[4];
+                std::memcpy(record, data + i * recordSize, recordSize);
+                ContainerContext::setLayout(componentIds[i], record[0], record[1], record[2],
+                                            record[3]);
+            }
+        });
+    }
+
+    bool HybridStyleRegistry::updateComponentStateForTag(facebook::react::Tag tag,
+                                                         PseudoClassType type, bool value) {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+        const std::string *linked = shadowUpdates_->tags().find(tag);
+        if (linked == nullptr) {
+            return false;
+        }
+
+        // The flip, the recompute and the staging commit run here, so the view updates
+        // without waiting for the JS thread. Rerenders and platform colors that need
+        // processColor are handed to it.
+        const std::string componentId = *linked;
+        reactnativecss::Effect::batch([&]() {
+            PseudoClasses::set(componentId, type, value);
+        });
+        return true;
+    }
+
+    void HybridStyleRegistry::captureJsThread(jsi::Runtime &runtime) {
+        if (jsDispatcher_ != nullptr) return;
+        jsDispatcher_ = Dispatcher::getRuntimeGlobalDispatcher(runtime);
+        jsThreadId_ = std::this_thread::get_id();
+
+        // Native threads hand rerenders and processColor conversions to the JS thread
+        rerenders_->setDispatch([](std::function<void()> &&deliver) {
+            runOnJsThread(std::move(deliver));
+        });
+        shadowUpdates_->setJsDispatch([](std::function<void()> &&task) {
+            runOnJsThread([task = std::move(task)]() {
+                std::lock_guard<std::recursive_mutex> jsLock(mutex_);
+                task();
+            });
+        });
+    }
+
+    void HybridStyleRegistry::runOnJsThread(std::function<void()> &&task) {
+        if (jsDispatcher_ == nullptr || std::this_thread::get_id() == jsThreadId_) {
+            task();
+            return;
+        }
+        jsDispatcher_->runAsync(std::move(task));
+    }
+
+    void HybridStyleRegistry::setRerenderHandler(
+            const std::function<void(const std::vector<std::string> &)> &handler) {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        rerenders_->setHandler(handler);
+    }
+
     void HybridStyleRegistry::unlinkComponent(const std::string &componentId) {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
         shadowUpdates_->unlinkComponent(componentId);
     }
 
     void HybridStyleRegistry::setWindowDimensions(double width, double height, double scale,
                                                   double fontScale) {
-        reactnativecss::env::setWindowDimensions(width, height, scale, fontScale);
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+        // Batch so an orientation change (width and height) recomputes dependents once
+        reactnativecss::Effect::batch([&]() {
+            reactnativecss::env::setWindowDimensions(width, height, scale, fontScale);
+        });
+
+        // Layout changes smaller than a physical pixel are not visible, don't propagate them
+        ContainerContext::setLayoutQuantum(scale > 0.0 ? 1.0 / scale : 0.0);
     }
 
     jsi::Value
     HybridStyleRegistry::linkComponent(jsi::Runtime &runtime, const jsi::Value &thisValue,
                                        const jsi::Value *args, size_t count) {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
         (void) thisValue;
 
         if (count < 2) {
@@ -283,14 +567,114 @@ namespace margelo::nitro::cssnitro {
         std::string componentId = args[0].getString(runtime).utf8(runtime);
         auto tagValue = static_cast<facebook::react::Tag>(static_cast<int64_t>(args[1].getNumber()));
 
+        captureJsThread(runtime);
         shadowUpdates_->linkComponent(runtime, componentId, tagValue);
 
         return jsi::Value::undefined();
     }
 
+    PseudoClassType HybridStyleRegistry::commandPseudoClass(double type) {
+        // Mapped rather than cast, the wire values are fixed by the encoder while the spec
+        // enum is generated. Decoding has rejected any other value.
+        switch (static_cast<CommandPseudoClass>(static_cast<int>(type))) {
+            case CommandPseudoClass::Active:
+                return PseudoClassType::ACTIVE;
+            case CommandPseudoClass::Hover:
+                return PseudoClassType::HOVER;
+            case CommandPseudoClass::Focus:
+                return PseudoClassType::FOCUS;
+        }
+        return PseudoClassType::ACTIVE;
+    }
+
+    jsi::Value
+    HybridStyleRegistry::submitCommands(jsi::Runtime &runtime, const jsi::Value &thisValue,
+                                        const jsi::Value *args, size_t count) {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        (void) thisValue;
+
+        // args: [commands: ArrayBuffer, componentIds: string[]]
+        if (count < 2 || !args[0].isObject() || !args[1].isObject()) {
+            return jsi::Value::undefined();
+        }
+        captureJsThread(runtime);
+        auto commandsObject = args[0].asObject(runtime);
+        auto idsObject = args[1].asObject(runtime);
+        if (!commandsObject.isArrayBuffer(runtime) || !idsObject.isArray(runtime)) {
+            return jsi::Value::undefined();
+        }
+
+        auto commands = commandsObject.getArrayBuffer(runtime);
+        auto idsArray = idsObject.getArray(runtime);
+
+        // Only IDs that are given a handle by this buffer are sent
+        std::vector<std::string> componentIds;
+        const size_t idCount = idsArray.size(runtime);
+        componentIds.reserve(idCount);
+        for (size_t i = 0; i < idCount; i++) {
+            auto componentId = idsArray.getValueAtIndex(runtime, i).asString(runtime);
+            componentIds.push_back(componentId.utf8(runtime));
+        }
+
+        // One batch for every command, dependents recompute once
+        reactnativecss::Effect::batch([&]() {
+            RegistryCommands::decode(
+                    commands.data(runtime), commands.size(runtime), componentIds.size(),
+                    [&](const RegistryCommand &command) {
+                        if (command.op == RegistryOp::Define) {
+                            componentHandles_.define(
+                                    command.handle,
+                                    componentIds[static_cast<size_t>(command.args[0])]);
+                            return;
+                        }
+                        if (command.op == RegistryOp::Release) {
+                            componentHandles_.release(command.handle);
+                            return;
+                        }
+
+                        // Commands for a released handle are dropped
+                        const std::string *handleId = componentHandles_.find(command.handle);
+                        if (handleId == nullptr) {
+                            return;
+                        }
+                        const std::string &componentId = *handleId;
+                        switch (command.op) {
+                            case RegistryOp::State:
+                                PseudoClasses::set(componentId,
+                                                   commandPseudoClass(command.args[0]),
+                                                   command.args[1] != 0);
+                                break;
+                            case RegistryOp::Layout:
+                                ContainerContext::setLayout(componentId, command.args[0],
+                                                            command.args[1], command.args[2],
+                                                            command.args[3]);
+                                break;
+                            case RegistryOp::Link:
+                                shadowUpdates_->linkComponent(
+                                        runtime, componentId,
+                                        static_cast<facebook::react::Tag>(
+                                                static_cast<int64_t>(command.args[0])));
+                                break;
+                            case RegistryOp::Unlink:
+                                shadowUpdates_->unlinkComponent(componentId);
+                                break;
+                            case RegistryOp::Deregister:
+                                deregisterComponent(componentId);
+                                break;
+                            case RegistryOp::Define:
+                            case RegistryOp::Release:
+                                break;
+                        }
+                    });
+        });
+
+        return jsi::Value::undefined();
+    }
+
     jsi::Value
     HybridStyleRegistry::registerExternalMethods(jsi::Runtime &runtime, const jsi::Value &thisValue,
                                                  const jsi::Value *args, size_t count) {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
         (void) thisValue;
 
         // Initialize JSLogger on first call with runtime access
@@ -323,6 +707,11 @@ namespace margelo::nitro::cssnitro {
                     2,
                     &HybridStyleRegistry::linkComponent);
 
+            prototype.registerRawHybridMethod(
+                    "submitCommands",
+                    2,
+                    &HybridStyleRegistry::submitCommands);
+
             prototype.registerRawHybridMethod(
                     "registerExternalMethods",
                     1,
@@ -340,6 +729,7 @@ namespace margelo::nitro::cssnitro {
 
     void HybridStyleRegistry::setKeyframes(const std::string &name,
                                            const std::shared_ptr<AnyMap> &keyframes) {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
         reactnativecss::animations::setKeyframes(name, keyframes);
     }
 
@@ -4,15 +4,23 @@
 #include "Observable.hpp"
 #include "HybridStyleRule+Equality.hpp"
 #include "Styled+Equality.hpp"
+#include "ComponentHandles.hpp"
+#include "ScopeUsers.hpp"
 
+#include <react/renderer/core/ReactPrimitives.h>
+#include <NitroModules/Dispatcher.hpp>
+
+#include <atomic>
 #include <cstddef>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <variant>
 #include <vector>
@@ -20,12 +28,20 @@
 namespace reactnativecss {
     template<typename T>
     class Computed;
+
+    class Effect;
 }
 
 namespace margelo::nitro::cssnitro {
 
     class ShadowTreeUpdateManager;
 
+    class AnimationDriver;
+
+    class FrameTicker;
+
+    class RerenderQueue;
+
     class HybridStyleRegistry : public HybridStyleRegistrySpec {
     public:
         HybridStyleRegistry();
@@ -63,8 +79,14 @@ namespace margelo::nitro::cssnitro {
         void updateComponentLayout(const std::string &componentId,
                                    const LayoutRectangle &value) override;
 
+        void updateComponentLayouts(const std::vector<std::string> &componentIds,
+                                    const std::shared_ptr<ArrayBuffer> &layouts) override;
+
         void unlinkComponent(const std::string &componentId) override;
 
+        void setRerenderHandler(
+                const std::function<void(const std::vector<std::string> &)> &handler) override;
+
         void updateComponentInlineStyleKeys(const std::string &componentId,
                                             const std::vector<std::string> &inlineStyleKeys) override;
 
@@ -74,6 +96,40 @@ namespace margelo::nitro::cssnitro {
         void
         setKeyframes(const std::string &name, const std::shared_ptr<AnyMap> &keyframes) override;
 
+        // Per-component native state that is still alive, for leak checks
+        struct LiveStateCounts {
+            size_t components;
+            size_t retainedScopes;
+            size_t pseudoClasses;
+            size_t containers;
+            size_t variableContexts;
+            size_t animationScopes;
+            size_t animatedComponents;
+            size_t pendingRerenders;
+            size_t componentHandles;
+        };
+
+        /**
+         * Count the per-component native structures that are currently alive.
+         * After every component has been deregistered these return to their
+         * initial values (variableContexts keeps "root" and "universal").
+         */
+        static LiveStateCounts getLiveStateCounts();
+
+        /**
+         * Native fast path for pseudo-class changes.
+         *
+         * Flips the pseudo-class state of the component linked to a native view tag and
+         * pushes the restyled result straight into the shadow-tree update queue, without
+         * a round trip through the JS event handlers. Callable from a native touch/focus
+         * handler on any thread. The state, the restyle and the commit are applied before
+         * it returns, only rerenders and processColor conversions go through the JS thread.
+         *
+         * @return false if no component is linked to the tag
+         */
+        static bool updateComponentStateForTag(facebook::react::Tag tag, PseudoClassType type,
+                                               bool value);
+
     protected:
         void loadHybridMethods() override;
 
@@ -82,6 +138,11 @@ namespace margelo::nitro::cssnitro {
                                  const jsi::Value &thisValue,
                                  const jsi::Value *args, size_t count);
 
+        // Decode a command buffer (see RegistryCommands) and apply it in one batch
+        jsi::Value submitCommands(jsi::Runtime &runtime,
+                                  const jsi::Value &thisValue,
+                                  const jsi::Value *args, size_t count);
+
         jsi::Value registerExternalMethods(jsi::Runtime &runtime,
                                            const jsi::Value &thisValue,
                                            const jsi::Value *args, size_t count);
@@ -89,16 +150,61 @@ namespace margelo::nitro::cssnitro {
         // Struct to hold computed with its associated parameters
         struct ComputedEntry {
             std::shared_ptr<reactnativecss::Computed<Styled *>> computed;
+            // Matches the rules and applies their inline variables, feeding the computed
+            std::shared_ptr<reactnativecss::Effect> rulesEffect;
+            std::shared_ptr<reactnativecss::Observable<std::shared_ptr<const std::vector<HybridStyleRule>>>> matchedRules;
             std::string classNames;
             std::string variableScope;
             std::string containerScope;
         };
 
+        // Dispose an entry's reactive nodes and free its last Styled value
+        static void disposeEntry(ComputedEntry &entry);
+
+        // Free the state keyed by a scope: variables, container layout and keyframes
+        static void freeScope(const std::string &scope);
+
+        // Convert and cache the colors held by variables, see ShadowTreeUpdateManager::precomputeColors
+        static void precomputeVariableColors(const std::shared_ptr<AnyMap> &variables);
+
+        // Tick the animation driver on a native thread while any animation is running,
+        // writing its frames to the shadow tree
+        static void startAnimationTimer();
+
+        // One tick of animationTicker_, applies the frame on the ticker's thread
+        static bool animationFrame();
+
+        // Stage the current frame of every animation in one batch, under mutex_
+        static void applyAnimationFrame();
+
+        // The pseudo-class of a State command's validated type
+        static PseudoClassType commandPseudoClass(double type);
+
+        // Remember the JS thread and its dispatcher, called from JS entry points. Rerenders
+        // and processColor conversions from native threads are sent through it from then on.
+        static void captureJsThread(jsi::Runtime &runtime);
+
+        // Run a task on the JS thread, inline when already on it or none is known yet
+        static void runOnJsThread(std::function<void()> &&task);
+
         // Static shared state
         static std::unique_ptr<ShadowTreeUpdateManager> shadowUpdates_;
+        static std::unique_ptr<AnimationDriver> animationDriver_;
+        static std::unique_ptr<RerenderQueue> rerenders_;
         static std::unordered_map<std::string, ComputedEntry> computedMap_;
+        // The registered components reading each variable/container scope. A scope keyed by a
+        // deregistered component is only freed once its last reader is gone.
+        static ScopeUsers scopeUsers_;
         static std::unordered_map<std::string, std::shared_ptr<reactnativecss::Observable<std::vector<HybridStyleRule>>>> styleRuleMap_;
         static std::atomic<uint64_t> nextStyleRuleId_;
+        static std::shared_ptr<Dispatcher> jsDispatcher_;
+        static std::thread::id jsThreadId_;
+
+        // Guards the static state above, the registry can be driven from JS and native threads
+        static std::recursive_mutex mutex_;
+        // The component IDs behind command buffer handles
+        static ComponentHandles componentHandles_;
+        static FrameTicker animationTicker_;
     };
 
 } // namespace margelo::nitro::cssnitro
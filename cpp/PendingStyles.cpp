@@ -0,0 +1,57 @@
+#include "PendingStyles.hpp"
+
+#include <algorithm>
+
+namespace margelo::nitro::cssnitro {
+
+    PendingStyles::Entry &PendingStyles::entry(const std::string &componentId) {
+        auto it = entries_.find(componentId);
+        if (it != entries_.end()) {
+            return it->second;
+        }
+
+        if (capacity_ > 0 && entries_.size() >= capacity_) {
+            entries_.erase(order_.front());
+            order_.pop_front();
+        }
+        order_.push_back(componentId);
+        return entries_[componentId];
+    }
+
+    void PendingStyles::replace(const std::string &componentId, AnyObject style) {
+        if (capacity_ == 0) {
+            return;
+        }
+        Entry &parked = entry(componentId);
+        parked.style = std::move(style);
+        parked.full = true;
+    }
+
+    void PendingStyles::merge(const std::string &componentId, const AnyObject &entries) {
+        if (capacity_ == 0) {
+            return;
+        }
+        Entry &parked = entry(componentId);
+        for (const auto &kv: entries) {
+            parked.style[kv.first] = kv.second;
+        }
+    }
+
+    std::optional<PendingStyles::Entry> PendingStyles::take(const std::string &componentId) {
+        auto it = entries_.find(componentId);
+        if (it == entries_.end()) {
+            return std::nullopt;
+        }
+        std::optional<Entry> parked = std::move(it->second);
+        erase(componentId);
+        return parked;
+    }
+
+    void PendingStyles::erase(const std::string &componentId) {
+        if (entries_.erase(componentId) == 0) {
+            return;
+        }
+        order_.erase(std::find(order_.begin(), order_.end(), componentId));
+    }
+
+} // namespace margelo::nitro::cssnitro
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include <NitroModules/AnyMap.hpp>
+
+namespace margelo::nitro::cssnitro {
+
+    using ::margelo::nitro::AnyObject;
+
+    /**
+     * Style updates of components that aren't linked to a view yet, e.g. a style change
+     * while the component mounts. They are replayed once the component links. The buffer
+     * is bounded, past its capacity the oldest component's updates are dropped and it
+     * keeps the style it rendered with.
+     */
+    class PendingStyles {
+    public:
+        struct Entry {
+            AnyObject style;
+            // Whether style is the full resolved style, keys it doesn't set are reset
+            bool full = false;
+        };
+
+        explicit PendingStyles(size_t capacity) : capacity_(capacity) {}
+
+        // Park the full resolved style, replacing anything parked before
+        void replace(const std::string &componentId, AnyObject style);
+
+        // Park a partial update, e.g. an animation frame, over anything parked before
+        void merge(const std::string &componentId, const AnyObject &entries);
+
+        // Remove and return the component's parked updates
+        std::optional<Entry> take(const std::string &componentId);
+
+        void erase(const std::string &componentId);
+
+        size_t size() const {
+            return entries_.size();
+        }
+
+    private:
+        size_t capacity_;
+        std::unordered_map<std::string, Entry> entries_;
+        // Component IDs, oldest first
+        std::deque<std::string> order_;
+
+        Entry &entry(const std::string &componentId);
+    };
+
+} // namespace margelo::nitro::cssnitro
@@ -2,96 +2,133 @@
 
 namespace margelo::nitro::cssnitro {
 
-    // Initialize the static map
-    std::unordered_map<std::string, PseudoClassState> PseudoClasses::states;
+    // Initialize the static storage
+    std::unordered_map<std::string, uint32_t> PseudoClasses::slotIndex;
+    std::vector<PseudoClassSlot> PseudoClasses::slots;
+    std::vector<uint32_t> PseudoClasses::freeSlots;
+    std::array<std::shared_ptr<reactnativecss::Observable<uint32_t>>, PseudoClasses::kUnsetBuckets * 3> PseudoClasses::unsetReaders;
 
-    bool PseudoClasses::get(const std::string &key, PseudoClassType type,
-                            reactnativecss::Effect::GetProxy &get) {
-        // Find or create the state for this key
-        auto stateIt = states.find(key);
-        if (stateIt == states.end()) {
-            // Key doesn't exist, create it
-            PseudoClassState newState;
-            states[key] = newState;
-            stateIt = states.find(key);
-        }
-
-        auto &state = stateIt->second;
-
-        // Get the appropriate observable based on type
-        std::optional<std::shared_ptr<reactnativecss::Observable<bool>>> *observablePtr = nullptr;
-
-        // Select the correct observable based on the PseudoClassType
+    size_t PseudoClasses::bitIndex(PseudoClassType type) {
         switch (type) {
             case PseudoClassType::ACTIVE:
-                observablePtr = &state.active;
-                break;
+                return 0;
             case PseudoClassType::HOVER:
-                observablePtr = &state.hover;
-                break;
+                return 1;
             case PseudoClassType::FOCUS:
-                observablePtr = &state.focus;
-                break;
+                return 2;
         }
+        return 0;
+    }
 
-        // Safety check - should never happen but guards against warnings
-        if (observablePtr == nullptr) {
-            return false;
+    uint32_t PseudoClasses::acquireSlot(const std::string &key) {
+        auto it = slotIndex.find(key);
+        if (it != slotIndex.end()) {
+            return it->second;
         }
 
-        // If the observable doesn't exist, create it with default value of false
-        if (!observablePtr->has_value()) {
-            *observablePtr = reactnativecss::Observable<bool>::create(false);
+        // Reuse a released slot before growing the array
+        uint32_t index;
+        if (!freeSlots.empty()) {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+            slots[index] = PseudoClassSlot{};
+        } else {
+            index = static_cast<uint32_t>(slots.size());
+            slots.emplace_back();
         }
 
-        // Subscribe to the observable and return its value
-        return get(*observablePtr->value());
+        slotIndex.emplace(key, index);
+        return index;
     }
 
-    void PseudoClasses::set(const std::string &key, PseudoClassType type, bool value) {
-        // Find or create the state for this key
-        auto stateIt = states.find(key);
-        if (stateIt == states.end()) {
-            // Key doesn't exist, create it
-            PseudoClassState newState;
-            states[key] = newState;
-            stateIt = states.find(key);
+    std::shared_ptr<reactnativecss::Observable<uint32_t>> &
+    PseudoClasses::unsetReader(const std::string &key, size_t bit) {
+        const size_t bucket = std::hash<std::string>{}(key) % kUnsetBuckets;
+        auto &reader = unsetReaders[bit * kUnsetBuckets + bucket];
+        if (!reader) {
+            reader = reactnativecss::Observable<uint32_t>::create(0u);
         }
+        return reader;
+    }
 
-        auto &state = stateIt->second;
+    bool PseudoClasses::get(const std::string &key, PseudoClassType type,
+                            reactnativecss::Effect::GetProxy &get) {
+        const size_t bit = bitIndex(type);
 
-        // Get the appropriate observable based on type
-        std::optional<std::shared_ptr<reactnativecss::Observable<bool>>> *observablePtr = nullptr;
+        // Nothing was set for this key, wait on the shared reader instead of storing a slot
+        auto it = slotIndex.find(key);
+        if (it == slotIndex.end()) {
+            get(*unsetReader(key, bit));
+            return false;
+        }
 
-        switch (type) {
-            case PseudoClassType::ACTIVE:
-                observablePtr = &state.active;
-                break;
-            case PseudoClassType::HOVER:
-                observablePtr = &state.hover;
-                break;
-            case PseudoClassType::FOCUS:
-                observablePtr = &state.focus;
-                break;
+        // Attach the subscriber list for this bit on first subscription
+        PseudoClassSlot &slot = slots[it->second];
+        auto &listener = slot.listeners[bit];
+        if (!listener) {
+            listener = reactnativecss::Observable<bool>::create((slot.bits & (1u << bit)) != 0);
+        }
+
+        // Subscribe to the observable and return its value
+        return get(*listener);
+    }
+
+    void PseudoClasses::set(const std::string &key, PseudoClassType type, bool value) {
+        const size_t bit = bitIndex(type);
+
+        auto it = slotIndex.find(key);
+        if (it == slotIndex.end() && !value) {
+            // Unset pseudo-classes are already false, nothing to store
+            return;
         }
 
-        // Safety check - should never happen but guards against warnings
-        if (observablePtr == nullptr) {
+        PseudoClassSlot &slot = slots[it != slotIndex.end() ? it->second : acquireSlot(key)];
+        const auto mask = static_cast<uint8_t>(1u << bit);
+        const bool current = (slot.bits & mask) != 0;
+        if (current == value) {
             return;
         }
 
-        // If the observable doesn't exist, create it
-        if (!observablePtr->has_value()) {
-            *observablePtr = reactnativecss::Observable<bool>::create(value);
+        slot.bits = static_cast<uint8_t>(value ? (slot.bits | mask) : (slot.bits & ~mask));
+
+        // Only notify subscribers of this pseudo-class. Without a listener, its readers (if
+        // any) are waiting on the shared reader and attach a listener when they re-run.
+        if (slot.listeners[bit]) {
+            slot.listeners[bit]->set(value);
         } else {
-            // Update the existing observable
-            observablePtr->value()->set(value);
+            auto &reader = unsetReader(key, bit);
+            reader->set(reader->get() + 1);
         }
     }
 
     void PseudoClasses::remove(const std::string &key) {
-        // Remove the key from the map
-        states.erase(key);
+        auto it = slotIndex.find(key);
+        if (it == slotIndex.end()) {
+            return;
+        }
+
+        uint32_t index = it->second;
+        slotIndex.erase(it);
+
+        // Readers hold the listeners weakly, tell them the state is gone before dropping them
+        PseudoClassSlot slot = std::move(slots[index]);
+        slots[index] = PseudoClassSlot{};
+        freeSlots.push_back(index);
+        reactnativecss::Effect::batch([&]() {
+            for (auto &listener: slot.listeners) {
+                if (listener) {
+                    listener->set(false);
+                }
+            }
+        });
+    }
+
+    size_t PseudoClasses::size() {
+        return slotIndex.size();
+    }
+
+    size_t PseudoClasses::capacity() {
+        return slots.size();
     }
 
 } // namespace margelo::nitro::cssnitro
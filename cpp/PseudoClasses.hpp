@@ -1,29 +1,48 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <unordered_map>
 #include <memory>
-#include <optional>
+#include <vector>
 #include "Observable.hpp"
 #include "Effect.hpp"
 #include "HybridStyleRegistrySpec.hpp"
 
 namespace margelo::nitro::cssnitro {
 
-    struct PseudoClassState {
-        std::optional<std::shared_ptr<reactnativecss::Observable<bool>>> active;
-        std::optional<std::shared_ptr<reactnativecss::Observable<bool>>> hover;
-        std::optional<std::shared_ptr<reactnativecss::Observable<bool>>> focus;
+    // Per-component pseudo-class state: one bit per pseudo-class, plus a subscriber
+    // list per bit that is only attached once something subscribes to that bit.
+    struct PseudoClassSlot {
+        uint8_t bits = 0;
+        std::array<std::shared_ptr<reactnativecss::Observable<bool>>, 3> listeners;
     };
 
     class PseudoClasses {
     private:
-        static std::unordered_map<std::string, PseudoClassState> states;
+        // Readers of a pseudo-class without a listener share one of these per bit, chosen by
+        // the key's hash. Setting such a pseudo-class wakes its share of them.
+        static constexpr size_t kUnsetBuckets = 64;
+
+        // key -> index into slots
+        static std::unordered_map<std::string, uint32_t> slotIndex;
+        static std::vector<PseudoClassSlot> slots;
+        static std::vector<uint32_t> freeSlots;
+        static std::array<std::shared_ptr<reactnativecss::Observable<uint32_t>>, kUnsetBuckets * 3> unsetReaders;
+
+        static size_t bitIndex(PseudoClassType type);
+
+        static uint32_t acquireSlot(const std::string &key);
+
+        static std::shared_ptr<reactnativecss::Observable<uint32_t>> &
+        unsetReader(const std::string &key, size_t bit);
 
     public:
         /**
-         * Get the value of a pseudo-class for a given key.
-         * If the key or type doesn't exist, it will be created with a default value of false.
+         * Get the value of a pseudo-class for a given key and subscribe to changes.
+         * Unset pseudo-classes default to false, reading them stores nothing for the key.
          *
          * @param key The component/element key
          * @param type The pseudo-class type (active, hover, or focus)
@@ -35,6 +54,7 @@ namespace margelo::nitro::cssnitro {
 
         /**
          * Set the value of a pseudo-class for a given key.
+         * Flips the bit and only notifies subscribers of that pseudo-class.
          *
          * @param key The component/element key
          * @param type The pseudo-class type (active, hover, or focus)
@@ -43,11 +63,22 @@ namespace margelo::nitro::cssnitro {
         static void set(const std::string &key, PseudoClassType type, bool value);
 
         /**
-         * Remove a key and all its pseudo-class states from the map.
+         * Remove a key and all its pseudo-class states. Readers of a set pseudo-class are
+         * notified that it is unset.
          *
          * @param key The component/element key to remove
          */
         static void remove(const std::string &key);
+
+        /**
+         * The number of keys currently holding pseudo-class state.
+         */
+        static size_t size();
+
+        /**
+         * The number of allocated slots, including released ones waiting to be reused.
+         */
+        static size_t capacity();
     };
 
 } // namespace margelo::nitro::cssnitro
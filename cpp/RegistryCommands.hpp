@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace margelo::nitro::cssnitro {
+
+    /**
+     * The operations of a registry command buffer.
+     *
+     * A buffer is a sequence of doubles. Each command starts with its opcode and a component
+     * handle, followed by a fixed number of arguments. Handles are small integers JS assigns
+     * to component IDs, so an ID string crosses JSI once, when its handle is defined, rather
+     * than with every command. A released handle may be defined again for another ID.
+     *
+     *   State      [0, handle, type, value]      type: 0 active, 1 hover, 2 focus, value: 0 or 1
+     *   Layout     [1, handle, x, y, width, height]
+     *   Link       [2, handle, tag]
+     *   Unlink     [3, handle]
+     *   Deregister [4, handle]
+     *   Define     [5, handle, index]            index into the buffer's new component IDs
+     *   Release    [6, handle]
+     */
+    enum class RegistryOp : uint8_t {
+        State = 0,
+        Layout = 1,
+        Link = 2,
+        Unlink = 3,
+        Deregister = 4,
+        Define = 5,
+        Release = 6,
+    };
+
+    // The pseudo-class types of a State command, fixed by the JS encoder
+    enum class CommandPseudoClass : uint8_t {
+        Active = 0,
+        Hover = 1,
+        Focus = 2,
+    };
+
+    struct RegistryCommand {
+        RegistryOp op;
+        size_t handle;
+        double args[4];
+    };
+
+    class RegistryCommands {
+    public:
+        // JS reuses released handles, so they stay below the number of mounted components
+        static constexpr size_t kMaxHandles = 1 << 20;
+
+        // The number of arguments following the opcode and handle, or -1 for an unknown opcode
+        static int arity(double opcode) {
+            if (!(opcode >= 0 && opcode <= static_cast<double>(RegistryOp::Release))) {
+                return -1;
+            }
+            switch (static_cast<int>(opcode)) {
+                case static_cast<int>(RegistryOp::State):
+                    return 2;
+                case static_cast<int>(RegistryOp::Layout):
+                    return 4;
+                case static_cast<int>(RegistryOp::Link):
+                case static_cast<int>(RegistryOp::Define):
+                    return 1;
+                case static_cast<int>(RegistryOp::Unlink):
+                case static_cast<int>(RegistryOp::Deregister):
+                case static_cast<int>(RegistryOp::Release):
+                    return 0;
+                default:
+                    return -1;
+            }
+        }
+
+        // Whether the arguments of a decoded command are in range, idCount is the number of
+        // new component IDs sent with the buffer
+        static bool validArgs(const RegistryCommand &command, size_t idCount) {
+            switch (command.op) {
+                case RegistryOp::State: {
+                    const double type = command.args[0];
+                    const double value = command.args[1];
+                    return (type == static_cast<double>(CommandPseudoClass::Active) ||
+                            type == static_cast<double>(CommandPseudoClass::Hover) ||
+                            type == static_cast<double>(CommandPseudoClass::Focus)) &&
+                           (value == 0 || value == 1);
+                }
+                case RegistryOp::Define:
+                    return isIndex(command.args[0], idCount);
+                default:
+                    return true;
+            }
+        }
+
+        /**
+         * Decode a command buffer, calling apply(const RegistryCommand &) for each command in
+         * order. Decoding stops at the first malformed command: an unknown opcode, a handle that
+         * isn't an index below kMaxHandles, a truncated record or an argument out of range, e.g.
+         * an unknown pseudo-class or an ID index past idCount.
+         *
+         * @return The number of commands applied
+         */
+        template<typename Apply>
+        static size_t decode(const uint8_t *data, size_t size, size_t idCount, Apply &&apply) {
+            const size_t count = data != nullptr ? size / sizeof(double) : 0;
+            size_t applied = 0;
+            size_t i = 0;
+
+            while (i + 2 <= count) {
+                double opcode = read(data, i);
+                double handle = read(data, i + 1);
+                int args = arity(opcode);
+                if (args < 0 || !isIndex(handle, kMaxHandles) ||
+                    i + 2 + static_cast<size_t>(args) > count) {
+                    break;
+                }
+
+                RegistryCommand command{static_cast<RegistryOp>(static_cast<int>(opcode)),
+                                        static_cast<size_t>(handle), {0, 0, 0, 0}};
+                for (int arg = 0; arg < args; arg++) {
+                    command.args[arg] = read(data, i + 2 + arg);
+                }
+                if (!validArgs(command, idCount)) {
+                    break;
+                }
+                apply(command);
+
+                applied++;
+                i += 2 + static_cast<size_t>(args);
+            }
+            return applied;
+        }
+
+    private:
+        // A whole number in [0, bound)
+        static bool isIndex(double value, size_t bound) {
+            return value >= 0 && value < static_cast<double>(bound) &&
+                   value == static_cast<double>(static_cast<size_t>(value));
+        }
+
+        // The buffer comes from JS and may not be aligned for doubles
+        static double read(const uint8_t *data, size_t index) {
+            double value;
+            std::memcpy(&value, data + index * sizeof(double), sizeof(double));
+            return value;
+        }
+    };
+
+} // namespace margelo::nitro::cssnitro
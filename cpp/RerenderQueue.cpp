@@ -0,0 +1,84 @@
+#include "RerenderQueue.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace margelo::nitro::cssnitro {
+
+    RerenderQueue::RerenderQueue()
+            : requested_(reactnativecss::Observable<uint64_t>::create(0)) {
+        auto requested = requested_;
+        effect_ = std::make_shared<reactnativecss::Effect>(
+                [this, requested](reactnativecss::Effect::GetProxy &get) {
+                    (void) get(*requested);
+                    flush();
+                });
+        // Setup the subscription by doing a dummy get()
+        (void) requested_->get(*effect_);
+    }
+
+    void RerenderQueue::request(const std::string &componentId,
+                                const std::function<void()> &rerender) {
+        auto it = callbacks_.find(componentId);
+        if (it != callbacks_.end()) {
+            // Keep the latest callback, the component may have remounted
+            it->second = rerender;
+            return;
+        }
+
+        bool wake = order_.empty();
+        order_.push_back(componentId);
+        callbacks_.emplace(componentId, rerender);
+        if (wake) {
+            requested_->set(requested_->get() + 1);
+        }
+    }
+
+    void RerenderQueue::cancel(const std::string &componentId) {
+        if (callbacks_.erase(componentId) == 0) {
+            return;
+        }
+        order_.erase(std::find(order_.begin(), order_.end(), componentId));
+    }
+
+    void RerenderQueue::setHandler(Handler handler) {
+        handler_ = std::move(handler);
+    }
+
+    void RerenderQueue::setDispatch(Dispatch dispatch) {
+        dispatch_ = std::move(dispatch);
+    }
+
+    void RerenderQueue::flush() {
+        if (order_.empty()) {
+            return;
+        }
+
+        // Swap the requests out first, a rerender may request again
+        std::vector<std::string> componentIds;
+        std::unordered_map<std::string, std::function<void()>> callbacks;
+        componentIds.swap(order_);
+        callbacks.swap(callbacks_);
+
+        // The delivery owns what it calls, it may run after the handler was replaced
+        auto deliver = [handler = handler_, componentIds = std::move(componentIds),
+                callbacks = std::move(callbacks)]() {
+            if (handler) {
+                handler(componentIds);
+                return;
+            }
+            for (const auto &componentId: componentIds) {
+                const auto &rerender = callbacks.at(componentId);
+                if (rerender) {
+                    rerender();
+                }
+            }
+        };
+        if (dispatch_) {
+            dispatch_(std::move(deliver));
+        } else {
+            deliver();
+        }
+    }
+
+} // namespace margelo::nitro::cssnitro
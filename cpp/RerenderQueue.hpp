@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Effect.hpp"
+#include "Observable.hpp"
+
+namespace margelo::nitro::cssnitro {
+
+    /**
+     * Collects the components whose props changed and asks JS to rerender them once.
+     *
+     * Requests are deduplicated by component ID and delivered when the current reactive
+     * batch ends (immediately outside of one), after the native work that caused them.
+     * With a handler set, all IDs go to JS in a single call, which renders them together
+     * on the next frame. Otherwise each component's own rerender callback is called.
+     * Requests made on a native thread are delivered through the dispatch function, which
+     * hands them to the JS thread.
+     */
+    class RerenderQueue {
+    public:
+        using Handler = std::function<void(const std::vector<std::string> &)>;
+        // Runs a delivery where the rerender callbacks can be called
+        using Dispatch = std::function<void(std::function<void()> &&)>;
+
+        RerenderQueue();
+
+        RerenderQueue(const RerenderQueue &) = delete;
+
+        RerenderQueue &operator=(const RerenderQueue &) = delete;
+
+        void request(const std::string &componentId, const std::function<void()> &rerender);
+
+        // Drop a pending request, e.g. when the component is deregistered
+        void cancel(const std::string &componentId);
+
+        void setHandler(Handler handler);
+
+        // Without one, requests are delivered on the thread that flushes them
+        void setDispatch(Dispatch dispatch);
+
+        // Deliver the pending requests now
+        void flush();
+
+        // The number of components waiting for a rerender
+        size_t size() const {
+            return order_.size();
+        }
+
+    private:
+        // Component IDs in request order, and their rerender callbacks
+        std::vector<std::string> order_;
+        std::unordered_map<std::string, std::function<void()>> callbacks_;
+        Handler handler_;
+        Dispatch dispatch_;
+
+        // Bumped by the first request of a batch, the effect flushes once per batch
+        std::shared_ptr<reactnativecss::Observable<uint64_t>> requested_;
+        std::shared_ptr<reactnativecss::Effect> effect_;
+    };
+
+} // namespace margelo::nitro::cssnitro
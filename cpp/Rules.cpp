@@ -65,6 +65,68 @@ namespace margelo::nitro::cssnitro {
         return testMediaMap(*mediaMap, get);
     }
 
+    CompiledMedia Rules::compileMedia(const AnyObject &mediaObject) {
+        CompiledMedia media;
+
+        auto opIt = mediaObject.find("$$op");
+        if (opIt != mediaObject.end() && std::holds_alternative<std::string>(opIt->second)) {
+            const auto &logicOp = std::get<std::string>(opIt->second);
+            media.any = logicOp == "or";
+            media.negate = logicOp == "not";
+        }
+
+        for (const auto &[key, value]: mediaObject) {
+            // Skip the $$op key
+            if (key == "$$op") {
+                continue;
+            }
+
+            // Value should be an array with [operator, expectedValue]
+            if (!std::holds_alternative<AnyArray>(value)) {
+                continue;
+            }
+
+            const auto &valueArray = std::get<AnyArray>(value);
+            if (valueArray.size() < 2) {
+                continue;
+            }
+
+            CompiledMediaQuery query;
+            query.key = key;
+            if (std::holds_alternative<std::string>(valueArray[0])) {
+                query.op = std::get<std::string>(valueArray[0]);
+            }
+            query.value = valueArray[1];
+            media.queries.push_back(std::move(query));
+        }
+
+        return media;
+    }
+
+    bool Rules::testCompiledMedia(const CompiledMedia &media,
+                                  reactnativecss::Effect::GetProxy &get) {
+        // If there are no tests, the media always matches
+        if (media.queries.empty()) {
+            return true;
+        }
+
+        // Short-circuit: only subscribe to what decides the result
+        bool result = !media.any;
+        for (const auto &query: media.queries) {
+            bool passed = testMediaQuery(query.key, query.op, query.value, get);
+            if (media.any && passed) {
+                result = true;
+                break;
+            }
+            if (!media.any && !passed) {
+                result = false;
+                break;
+            }
+        }
+
+        return media.negate ? !result : result;
+    }
+
     bool Rules::testPseudoClasses(const PseudoClass &pseudoClass, const std::string &componentId,
                                   reactnativecss::Effect::GetProxy &get) {
         // Check active state
@@ -243,8 +305,7 @@ namespace margelo::nitro::cssnitro {
         } else if (key == "height") {
             left = get(reactnativecss::env::windowHeight());
         } else if (key == "resolution") {
-            // TODO: Need to get PixelRatio - for now return 1.0
-            left = 1.0; // PixelRatio.get()
+            left = get(reactnativecss::env::windowScale());
         } else {
             return false;
         }
@@ -287,24 +348,25 @@ namespace margelo::nitro::cssnitro {
             containerName = containerQuery.n.value();
         }
 
-        // Resolve the actual container scope using findInScope
-        auto resolvedScope = ContainerContext::findInScope(containerScope, containerName);
+        // Resolve the actual container (cached after the first lookup)
+        const ResolvedContainer *container = ContainerContext::resolve(containerScope,
+                                                                       containerName);
 
         // If we can't resolve the scope, the query fails
-        if (!resolvedScope.has_value()) {
+        if (container == nullptr) {
             return false;
         }
 
         // Test pseudo-classes if containerQuery.p is set
         if (containerQuery.p.has_value()) {
-            if (!testPseudoClasses(containerQuery.p.value(), resolvedScope.value(), get)) {
+            if (!testPseudoClasses(containerQuery.p.value(), *container->key, get)) {
                 return false;
             }
         }
 
         // Only test media queries if containerQuery.m is set
         if (containerQuery.m.has_value()) {
-            return testContainerMediaMap(*containerQuery.m.value(), get, resolvedScope.value());
+            return testContainerMediaMap(*containerQuery.m.value(), get, *container);
         }
 
         // If no media queries, the container query passes
@@ -313,7 +375,7 @@ namespace margelo::nitro::cssnitro {
 
     bool Rules::testContainerMediaMap(const AnyMap &containerMediaMap,
                                       reactnativecss::Effect::GetProxy &get,
-                                      const std::string &containerScope) {
+                                      const ResolvedContainer &container) {
         // Get all keys to check if empty
         auto keys = containerMediaMap.getAllKeys();
         if (keys.empty()) {
@@ -360,7 +422,7 @@ namespace margelo::nitro::cssnitro {
                 op = std::get<std::string>(valueArray[0]);
             }
 
-            bool testResult = testContainerMediaQuery(key, op, valueArray[1], get, containerScope);
+            bool testResult = testContainerMediaQuery(key, op, valueArray[1], get, container);
             results.push_back(testResult);
         }
 
@@ -402,11 +464,11 @@ namespace margelo::nitro::cssnitro {
     bool Rules::testContainerMediaQuery(const std::string &key, const std::string &op,
                                         const AnyValue &value,
                                         reactnativecss::Effect::GetProxy &get,
-                                        const std::string &containerScope) {
+                                        const ResolvedContainer &container) {
         if (op == "=") {
             if (key == "min-width") {
                 if (std::holds_alternative<double>(value)) {
-                    auto cw = ContainerContext::getWidth(containerScope, std::nullopt, get);
+                    auto cw = ContainerContext::getWidth(container, get);
                     if (!cw.has_value()) return false;
                     return cw.value() >= std::get<double>(value);
                 }
@@ -414,7 +476,7 @@ namespace margelo::nitro::cssnitro {
             }
             if (key == "max-width") {
                 if (std::holds_alternative<double>(value)) {
-                    auto cw = ContainerContext::getWidth(containerScope, std::nullopt, get);
+                    auto cw = ContainerContext::getWidth(container, get);
                     if (!cw.has_value()) return false;
                     return cw.value() <= std::get<double>(value);
                 }
@@ -422,7 +484,7 @@ namespace margelo::nitro::cssnitro {
             }
             if (key == "min-height") {
                 if (std::holds_alternative<double>(value)) {
-                    auto ch = ContainerContext::getHeight(containerScope, std::nullopt, get);
+                    auto ch = ContainerContext::getHeight(container, get);
                     if (!ch.has_value()) return false;
                     return ch.value() >= std::get<double>(value);
                 }
@@ -430,7 +492,7 @@ namespace margelo::nitro::cssnitro {
             }
             if (key == "max-height") {
                 if (std::holds_alternative<double>(value)) {
-                    auto ch = ContainerContext::getHeight(containerScope, std::nullopt, get);
+                    auto ch = ContainerContext::getHeight(container, get);
                     if (!ch.has_value()) return false;
                     return ch.value() <= std::get<double>(value);
                 }
@@ -439,8 +501,8 @@ namespace margelo::nitro::cssnitro {
             if (key == "orientation") {
                 if (std::holds_alternative<std::string>(value)) {
                     std::string orientation = std::get<std::string>(value);
-                    auto cw = ContainerContext::getWidth(containerScope, std::nullopt, get);
-                    auto ch = ContainerContext::getHeight(containerScope, std::nullopt, get);
+                    auto cw = ContainerContext::getWidth(container, get);
+                    auto ch = ContainerContext::getHeight(container, get);
                     if (!cw.has_value() || !ch.has_value()) return false;
                     if (orientation == "landscape") {
                         return ch.value() < cw.value();
@@ -462,9 +524,9 @@ namespace margelo::nitro::cssnitro {
 
         // Determine left value based on key and fetch only what's needed
         if (key == "width") {
-            leftOpt = ContainerContext::getWidth(containerScope, std::nullopt, get);
+            leftOpt = ContainerContext::getWidth(container, get);
         } else if (key == "height") {
-            leftOpt = ContainerContext::getHeight(containerScope, std::nullopt, get);
+            leftOpt = ContainerContext::getHeight(container, get);
         } else {
             return false;
         }
@@ -24,6 +24,22 @@ namespace margelo::nitro::cssnitro {
     using AnyArray = ::margelo::nitro::AnyArray;
     using AnyValue = ::margelo::nitro::AnyValue;
 
+    using AnyObject = ::margelo::nitro::AnyObject;
+
+    // A single media condition, e.g. ["min-width", ">=", 640]
+    struct CompiledMediaQuery {
+        std::string key;
+        std::string op;
+        AnyValue value;
+    };
+
+    // A media map parsed once, so evaluating it doesn't re-read the AnyMap
+    struct CompiledMedia {
+        bool any = false;    // "$$op": "or"
+        bool negate = false; // "$$op": "not"
+        std::vector<CompiledMediaQuery> queries;
+    };
+
     class Rules {
     public:
         static bool testRule(const HybridStyleRule &rule, reactnativecss::Effect::GetProxy &get,
@@ -34,6 +50,11 @@ namespace margelo::nitro::cssnitro {
         testVariableMedia(const std::shared_ptr<AnyMap> &mediaMap,
                           reactnativecss::Effect::GetProxy &get);
 
+        static CompiledMedia compileMedia(const AnyObject &mediaObject);
+
+        static bool testCompiledMedia(const CompiledMedia &media,
+                                      reactnativecss::Effect::GetProxy &get);
+
     private:
         static bool
         testPseudoClasses(const PseudoClass &pseudoClass, const std::string &componentId,
@@ -55,12 +76,12 @@ namespace margelo::nitro::cssnitro {
 
         static bool testContainerMediaMap(const AnyMap &containerMediaMap,
                                           reactnativecss::Effect::GetProxy &get,
-                                          const std::string &containerScope);
+                                          const ResolvedContainer &container);
 
         static bool testContainerMediaQuery(const std::string &key, const std::string &op,
                                             const AnyValue &value,
                                             reactnativecss::Effect::GetProxy &get,
-                                            const std::string &containerScope);
+                                            const ResolvedContainer &container);
     };
 
 } // namespace margelo::nitro::cssnitro
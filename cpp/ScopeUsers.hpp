@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+namespace margelo::nitro::cssnitro {
+
+    /**
+     * Counts the components reading each variable or container scope, so a scope's state
+     * is freed once both its owner and its last reader are gone. A component owns the scope
+     * named after it, its children read it, and either may be deregistered first.
+     */
+    class ScopeUsers {
+    public:
+        // Frees the state held for a scope
+        using Free = std::function<void(const std::string &)>;
+
+        explicit ScopeUsers(Free free) : free_(std::move(free)) {}
+
+        void retain(const std::string &scope) {
+            users_[scope]++;
+        }
+
+        // Frees the scope when this was the last reader of an orphaned scope
+        void release(const std::string &scope) {
+            auto it = users_.find(scope);
+            if (it == users_.end()) {
+                return;
+            }
+            if (--it->second > 0) {
+                return;
+            }
+            users_.erase(it);
+
+            // The owner is already gone, this was the last reader
+            if (orphaned_.erase(scope) > 0) {
+                free_(scope);
+            }
+        }
+
+        // The owner of a scope is gone, free it now or once its last reader releases it
+        void orphan(const std::string &scope) {
+            if (users_.count(scope) > 0) {
+                orphaned_.insert(scope);
+            } else {
+                free_(scope);
+            }
+        }
+
+        // The number of scopes with readers, orphaned ones included
+        size_t size() const {
+            return users_.size();
+        }
+
+    private:
+        Free free_;
+        std::unordered_map<std::string, size_t> users_;
+        std::unordered_set<std::string> orphaned_;
+    };
+
+} // namespace margelo::nitro::cssnitro
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <unordered_map>
+#include <utility>
+
+namespace margelo::nitro::cssnitro {
+
+    // What a single commit of staged shadow tree updates contained
+    struct CommitStats {
+        size_t tags = 0;
+        size_t properties = 0;
+        // How long the apply callback took, not how long the updates took to reach the screen
+        std::chrono::nanoseconds duration{0};
+    };
+
+    /**
+     * Buffers shadow tree updates between commit points.
+     *
+     * Updates staged for the same key (a view tag) are merged, with later properties
+     * winning, so a commit applies one payload per view no matter how many restyles
+     * happened since the last one. Free of React Native and Folly types, the payload is
+     * handled through Traits:
+     *
+     *   static void merge(Payload &into, Payload &&from);
+     *   static size_t count(const Payload &payload); // number of properties
+     */
+    template<typename Key, typename Payload, typename Traits>
+    class ShadowTreeStaging {
+    public:
+        using Updates = std::unordered_map<Key, Payload>;
+
+        void stage(const Key &key, Payload &&payload) {
+            auto it = pending_.find(key);
+            if (it == pending_.end()) {
+                pending_.emplace(key, std::move(payload));
+            } else {
+                Traits::merge(it->second, std::move(payload));
+            }
+        }
+
+        bool empty() const {
+            return pending_.empty();
+        }
+
+        // The number of keys with a staged update
+        size_t size() const {
+            return pending_.size();
+        }
+
+        /**
+         * Swap the staged updates out and hand them to apply(Updates &&) in a single call.
+         * Nothing is copied, and the buffer is empty before apply runs, so apply may stage
+         * again.
+         */
+        template<typename Apply>
+        CommitStats commit(Apply &&apply) {
+            CommitStats stats;
+            if (pending_.empty()) {
+                return stats;
+            }
+
+            Updates updates;
+            updates.swap(pending_);
+
+            stats.tags = updates.size();
+            for (const auto &entry: updates) {
+                stats.properties += Traits::count(entry.second);
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            apply(std::move(updates));
+            stats.duration = std::chrono::steady_clock::now() - start;
+            return stats;
+        }
+
+    private:
+        Updates pending_;
+    };
+
+} // namespace margelo::nitro::cssnitro
@@ -2,6 +2,9 @@
 
 #include "Observable.hpp"
 #include "Effect.hpp"
+#include "Color.hpp"
+#include "StyleKeys.hpp"
+#include "ViewStyles.hpp"
 
 #include <jsi/jsi.h>
 #include <folly/dynamic.h>
@@ -9,6 +12,7 @@
 #include <NitroModules/AnyMap.hpp>
 #include <variant>
 #include <functional>
+#include <thread>
 #include <type_traits>
 #include <string>
 #include <cctype>
@@ -21,26 +25,38 @@ namespace margelo::nitro::cssnitro {
     using reactnativecss::Observable;
     namespace nitro_ns = ::margelo::nitro;
 
-    ShadowTreeUpdateManager::ShadowTreeUpdateManager() = default;
+    ShadowTreeUpdateManager::ShadowTreeUpdateManager() : views_(kMaxPendingComponents) {}
+
+    static bool isComposite(const nitro_ns::AnyValue &value) {
+        return std::holds_alternative<nitro_ns::AnyArray>(value) ||
+               std::holds_alternative<nitro_ns::AnyObject>(value);
+    }
 
     struct VariantConverter {
-    private:
-        static bool containsColorInsensitive(const std::string &key) {
-            if (key.size() < 5) return false;
-            std::string lower;
-            lower.reserve(key.size());
-            for (char c: key)
-                lower.push_back(
-                        static_cast<char>(::tolower(static_cast<unsigned char>(c))));
-            return lower.find("color") != std::string::npos;
-        }
-
-    public:
+        // Convert the value of a style key, dispatching on the key's precomputed kind
+        static folly::dynamic convertEntry(ShadowTreeUpdateManager &self,
+                                           Runtime *runtime,
+                                           const std::string &key,
+                                           const nitro_ns::VariantType &var) {
+            switch (StyleKeys::classify(key)) {
+                case StyleKeyKind::Color:
+                    return self.processColorDynamic(runtime, convert(self, runtime, var, true));
+                case StyleKeyKind::Transform:
+                    // Transform functions never hold colors, their keys aren't classified
+                    return convert(self, runtime, var, false);
+                case StyleKeyKind::Dimension:
+                case StyleKeyKind::Passthrough:
+                    break;
+            }
+            return convert(self, runtime, var, true);
+        }
+
         static folly::dynamic convert(ShadowTreeUpdateManager &self,
-                                      Runtime &runtime,
-                                      const nitro_ns::VariantType &var) {
+                                      Runtime *runtime,
+                                      const nitro_ns::VariantType &var,
+                                      bool classifyKeys) {
             return std::visit(
-                    [&self, &runtime](auto &&arg) -> folly::dynamic {
+                    [&self, runtime, classifyKeys](auto &&arg) -> folly::dynamic {
                         using T = std::decay_t<decltype(arg)>;
                         if constexpr (std::is_same_v<T, int64_t>) {
                             return folly::dynamic(static_cast<int64_t>(arg));
@@ -54,19 +70,16 @@ namespace margelo::nitro::cssnitro {
                             folly::dynamic arr = folly::dynamic::array();
                             for (const auto &elem: arg) {
                                 const auto &v = static_cast<const nitro_ns::VariantType &>(elem);
-                                arr.push_back(convert(self, runtime, v));
+                                arr.push_back(convert(self, runtime, v, classifyKeys));
                             }
                             return arr;
                         } else if constexpr (std::is_same_v<T, nitro_ns::AnyObject>) {
                             folly::dynamic obj = folly::dynamic::object();
                             for (const auto &kv: arg) {
-                                auto dynVal = convert(self, runtime,
-                                                      static_cast<const nitro_ns::VariantType &>(kv.second));
-                                if (containsColorInsensitive(kv.first)) {
-                                    obj[kv.first] = self.processColorDynamic(runtime, dynVal);
-                                } else {
-                                    obj[kv.first] = std::move(dynVal);
-                                }
+                                const auto &v = static_cast<const nitro_ns::VariantType &>(kv.second);
+                                obj[kv.first] = classifyKeys
+                                                ? convertEntry(self, runtime, kv.first, v)
+                                                : convert(self, runtime, v, false);
                             }
                             return obj;
                         } else {
@@ -75,93 +88,332 @@ namespace margelo::nitro::cssnitro {
                     },
                     var);
         }
-
-        // Overload: convert an AnyMap directly (top-level style entry)
-        static folly::dynamic convert(ShadowTreeUpdateManager &self,
-                                      Runtime &runtime,
-                                      const std::shared_ptr<::margelo::nitro::AnyMap> &entry) {
-            folly::dynamic obj = folly::dynamic::object();
-            for (const auto &kv: entry->getMap()) {
-                const auto &v = static_cast<const nitro_ns::VariantType &>(kv.second);
-                auto dynVal = convert(self, runtime, v);
-                if (containsColorInsensitive(kv.first)) {
-                    obj[kv.first] = self.processColorDynamic(runtime, dynVal);
-                } else {
-                    obj[kv.first] = std::move(dynVal);
-                }
-            }
-            return obj;
-        }
     };
 
     void ShadowTreeUpdateManager::linkComponent(Runtime &runtime,
                                                 const std::string &componentId,
                                                 facebook::react::Tag tag) {
-        component_links_[componentId] = ComponentLink{tag, &runtime};
+        js_thread_id_ = std::this_thread::get_id();
+
+        auto &link = component_links_[componentId];
+        bool newView = link.tag != tag;
+        link.tag = tag;
+        link.runtime = &runtime;
+        tags_.link(componentId, tag);
         ensureRuntimeEffect(runtime);
+
+        // A new view starts out with the style it rendered with, the updates made before
+        // it existed are replayed against that, e.g. a style change during mount
+        stageChanges(componentId, link, views_.link(componentId, newView));
     }
 
     void ShadowTreeUpdateManager::unlinkComponent(const std::string &componentId) {
+        views_.unlink(componentId);
         auto it = component_links_.find(componentId);
-        if (it != component_links_.end()) component_links_.erase(it);
+        if (it != component_links_.end()) {
+            tags_.unlink(componentId);
+            component_links_.erase(it);
+        }
     }
 
-    bool ShadowTreeUpdateManager::hasComponent(const std::string &componentId) {
-        auto it = component_links_.find(componentId);
-        return (it == component_links_.end());
+    void ShadowTreeUpdateManager::removeComponent(const std::string &componentId) {
+        unlinkComponent(componentId);
+        views_.remove(componentId);
+    }
+
+    bool ShadowTreeUpdateManager::isLinked(const std::string &componentId) const {
+        return views_.isLinked(componentId);
     }
 
     void ShadowTreeUpdateManager::addUpdates(
             const std::string &componentId,
             const std::shared_ptr<::margelo::nitro::AnyMap> &styleMap) {
+        auto changes = views_.partial(componentId, styleMap->getMap());
+        if (changes.empty()) return;
+        stageChanges(componentId, component_links_.at(componentId), changes);
+    }
+
+    void ShadowTreeUpdateManager::updateStyle(
+            const std::string &componentId,
+            const std::shared_ptr<::margelo::nitro::AnyMap> &style,
+            const std::shared_ptr<::margelo::nitro::AnyMap> &importantStyle) {
+        auto changes = views_.full(componentId, mergeStyles(style, importantStyle));
+        if (changes.empty()) return;
+        stageChanges(componentId, component_links_.at(componentId), changes);
+    }
+
+    void ShadowTreeUpdateManager::markRendered(
+            const std::string &componentId,
+            const std::shared_ptr<::margelo::nitro::AnyMap> &style,
+            const std::shared_ptr<::margelo::nitro::AnyMap> &importantStyle) {
+        views_.rendered(componentId, mergeStyles(style, importantStyle));
+    }
+
+    nitro_ns::AnyObject ShadowTreeUpdateManager::mergeStyles(
+            const std::shared_ptr<::margelo::nitro::AnyMap> &style,
+            const std::shared_ptr<::margelo::nitro::AnyMap> &importantStyle) {
+        nitro_ns::AnyObject merged;
+        if (style) {
+            merged = style->getMap();
+        }
+        // Important declarations win
+        if (importantStyle) {
+            for (const auto &entry: importantStyle->getMap()) {
+                merged[entry.first] = entry.second;
+            }
+        }
+        return merged;
+    }
+
+    void ShadowTreeUpdateManager::stageChanges(const std::string &componentId,
+                                               ComponentLink &link,
+                                               const nitro_ns::AnyObject &changes) {
+        if (changes.empty() || link.runtime == nullptr) return;
+
+        // The queue was set up when the component was linked, on the JS thread
+        auto queueIt = runtimes_.find(link.runtime);
+        if (queueIt == runtimes_.end()) return;
+
+        // Only the changed keys are converted, static declaration values are spliced from
+        // the fragments converted at ingestion
+        bool wasDeferring = !link.deferredColors.empty();
+        folly::dynamic payload = folly::dynamic::object();
+        for (const auto &kv: changes) {
+            // Scalars are never cached, they skip the lookup
+            const folly::dynamic *fragment =
+                    isComposite(kv.second) ? findFragment(kv.first, kv.second) : nullptr;
+            if (fragment) {
+                payload[kv.first] = *fragment;
+                link.deferredColors.erase(kv.first);
+                continue;
+            }
+
+            color_deferred_ = false;
+            auto converted = VariantConverter::convertEntry(*this, link.runtime, kv.first,
+                                                            kv.second);
+            if (color_deferred_ && js_dispatch_) {
+                link.deferredColors[kv.first] = kv.second;
+            } else {
+                payload[kv.first] = std::move(converted);
+                link.deferredColors.erase(kv.first);
+            }
+        }
+
+        if (!wasDeferring && !link.deferredColors.empty()) {
+            js_dispatch_([this, componentId]() { stageDeferredColors(componentId); });
+        }
+        if (payload.empty()) return;
+
+        // Only the first staged update wakes the effect, it is pending until it commits
+        auto &queue = queueIt->second;
+        bool wake = queue.staging.empty();
+        queue.staging.stage(link.tag, std::move(payload));
+        if (wake) {
+            queue.staged->set(queue.staged->get() + 1);
+        }
+    }
+
+    void ShadowTreeUpdateManager::stageDeferredColors(const std::string &componentId) {
         auto it = component_links_.find(componentId);
-        if (it == component_links_.end()) return;
+        if (it == component_links_.end() || it->second.deferredColors.empty()) return;
+
+        nitro_ns::AnyObject deferred;
+        deferred.swap(it->second.deferredColors);
+        stageChanges(componentId, it->second, deferred);
+    }
+
+    void ShadowTreeUpdateManager::setJsDispatch(JsDispatch dispatch) {
+        js_dispatch_ = std::move(dispatch);
+    }
+
+    void ShadowTreeUpdateManager::DynamicStagingTraits::merge(folly::dynamic &into,
+                                                              folly::dynamic &&from) {
+        if (into.isObject() && from.isObject()) {
+            into.update(from);
+        } else {
+            into = std::move(from);
+        }
+    }
 
-        ComponentLink &link = it->second;
-        if (link.runtime == nullptr) return;
+    size_t ShadowTreeUpdateManager::DynamicStagingTraits::count(const folly::dynamic &payload) {
+        return payload.isObject() ? payload.size() : 0;
+    }
 
-        // Convert the single AnyMap to folly::dynamic
-        auto payload = VariantConverter::convert(*this, *link.runtime, styleMap);
+    CommitStats ShadowTreeUpdateManager::commitRuntime(Runtime *runtime) {
+        auto it = runtimes_.find(runtime);
+        if (it == runtimes_.end()) {
+            return {};
+        }
+        auto *uiManager = it->second.uiManager;
+        CommitStats stats = it->second.staging.commit([uiManager](UpdatesMap &&updates) {
+            ShadowTreeUpdateManager::applyUpdates(uiManager, std::move(updates));
+        });
+        if (stats.tags > 0) {
+            last_commit_ = stats;
+        }
+        return stats;
+    }
 
-        auto &obs = runtime_updates_[link.runtime];
-        if (!obs) {
-            obs = Observable<UpdatesMap>::create(UpdatesMap{});
+    CommitStats ShadowTreeUpdateManager::commit() {
+        CommitStats total;
+        for (auto &entry: runtimes_) {
+            CommitStats stats = commitRuntime(entry.first);
+            total.tags += stats.tags;
+            total.properties += stats.properties;
+            total.duration += stats.duration;
         }
+        return total;
+    }
 
-        UpdatesMap cur = obs->get();
-        cur[link.tag] = std::move(payload);
-        obs->set(std::move(cur));
+    const CommitStats &ShadowTreeUpdateManager::lastCommitStats() const {
+        return last_commit_;
     }
 
     void ShadowTreeUpdateManager::registerProcessColorFunction(jsi::Function &&fn) {
         this->process_color_ = std::make_shared<jsi::Function>(std::move(fn));
-        process_color_cache_.clear();
+        // Only drop the colors converted by the previous JS function, native ones still hold
+        for (auto it = process_color_cache_.begin(); it != process_color_cache_.end();) {
+            if (Color::parse(it->first)) {
+                ++it;
+            } else {
+                it = process_color_cache_.erase(it);
+            }
+        }
+    }
+
+    bool ShadowTreeUpdateManager::precomputeColor(const std::string &value) {
+        auto color = Color::parse(value);
+        if (!color) {
+            return false;
+        }
+        process_color_cache_.emplace(value, Color::toProcessed(*color));
+        return true;
+    }
+
+    void ShadowTreeUpdateManager::precomputeColors(
+            const std::shared_ptr<::margelo::nitro::AnyMap> &declarations) {
+        if (!declarations) {
+            return;
+        }
+        for (const auto &kv: declarations->getMap()) {
+            precomputeColors(kv.first, kv.second);
+        }
+    }
+
+    bool ShadowTreeUpdateManager::precomputeColors(const std::string &key,
+                                                   const nitro_ns::AnyValue &value) {
+        bool converted = true;
+        if (std::holds_alternative<std::string>(value)) {
+            if (StyleKeys::isColor(key)) {
+                converted = precomputeColor(std::get<std::string>(value));
+            }
+        } else if (std::holds_alternative<nitro_ns::AnyArray>(value)) {
+            // Items of an array take the key of the array, e.g. a color in a shadow list
+            for (const auto &item: std::get<nitro_ns::AnyArray>(value)) {
+                converted = precomputeColors(key, item) && converted;
+            }
+        } else if (std::holds_alternative<nitro_ns::AnyObject>(value)) {
+            for (const auto &kv: std::get<nitro_ns::AnyObject>(value)) {
+                converted = precomputeColors(kv.first, kv.second) && converted;
+            }
+        }
+        return converted;
+    }
+
+    // Arrays and objects whose items are all final. Functions and units are resolved per
+    // component, a value holding one never matches its raw declaration.
+    static bool isStaticComposite(const nitro_ns::AnyValue &value) {
+        if (std::holds_alternative<nitro_ns::AnyArray>(value)) {
+            const auto &arr = std::get<nitro_ns::AnyArray>(value);
+            if (!arr.empty() && std::holds_alternative<std::string>(arr[0]) &&
+                std::get<std::string>(arr[0]) == "fn") {
+                return false;
+            }
+            // Units are [{}, unit, value]
+            if (arr.size() >= 3 && std::holds_alternative<nitro_ns::AnyObject>(arr[0]) &&
+                std::get<nitro_ns::AnyObject>(arr[0]).empty() &&
+                std::holds_alternative<std::string>(arr[1])) {
+                return false;
+            }
+            for (const auto &item: arr) {
+                if (isComposite(item) && !isStaticComposite(item)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        if (std::holds_alternative<nitro_ns::AnyObject>(value)) {
+            for (const auto &kv: std::get<nitro_ns::AnyObject>(value)) {
+                if (isComposite(kv.second) && !isStaticComposite(kv.second)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void ShadowTreeUpdateManager::precomputeFragments(
+            const std::shared_ptr<::margelo::nitro::AnyMap> &declarations) {
+        if (!declarations) {
+            return;
+        }
+        for (const auto &kv: declarations->getMap()) {
+            // Platform colors need the JS processColor, those values are converted per update
+            bool native = precomputeColors(kv.first, kv.second);
+
+            // Scalars convert faster than they hash, only transforms, shadows and other
+            // composite values are worth caching
+            if (!native || !isStaticComposite(kv.second)) {
+                continue;
+            }
+
+            auto &fragments = fragments_[kv.first];
+            if (fragments.size() >= kMaxFragmentsPerKey || fragments.count(kv.second) > 0) {
+                continue;
+            }
+            fragments.emplace(kv.second,
+                              VariantConverter::convertEntry(*this, nullptr, kv.first, kv.second));
+        }
+    }
+
+    const folly::dynamic *ShadowTreeUpdateManager::findFragment(
+            const std::string &key, const nitro_ns::AnyValue &value) const {
+        auto it = fragments_.find(key);
+        if (it == fragments_.end()) {
+            return nullptr;
+        }
+        auto fragment = it->second.find(value);
+        if (fragment == it->second.end()) {
+            return nullptr;
+        }
+        return &fragment->second;
     }
 
     void ShadowTreeUpdateManager::ensureRuntimeEffect(Runtime &runtime) {
         auto *rt = &runtime;
-        auto rtObsIt = runtime_updates_.find(rt);
-        if (rtObsIt == runtime_updates_.end()) {
-            auto obs = Observable<UpdatesMap>::create(UpdatesMap{});
-            rtObsIt = runtime_updates_.emplace(rt, std::move(obs)).first;
-        }
-        if (runtime_effects_.find(rt) == runtime_effects_.end()) {
-            auto obs = rtObsIt->second;
-            auto effect = std::make_shared<reactnativecss::Effect>(
-                    [obs, rt](reactnativecss::Effect::GetProxy &get) {
-                        const ShadowTreeUpdateManager::UpdatesMap &updates = get(*obs);
-                        if (updates.empty()) return;
-                        ShadowTreeUpdateManager::applyUpdates(*rt, updates);
-                        obs->set(ShadowTreeUpdateManager::UpdatesMap{});
-                    });
-            // Setup the subscription by doing a dummy get()
-            (void) obs->get(*effect);
-            runtime_effects_.emplace(rt, std::move(effect));
-        }
-    }
-
-    // Process a single dynamic color value: if string -> call JSI fn (cached), else return as-is
-    folly::dynamic ShadowTreeUpdateManager::processColorDynamic(Runtime &runtime,
+        auto &queue = runtimes_[rt];
+        if (queue.effect) {
+            return;
+        }
+
+        auto binding = facebook::react::UIManagerBinding::getBinding(runtime);
+        queue.uiManager = binding ? &binding->getUIManager() : nullptr;
+        queue.staged = Observable<uint64_t>::create(0);
+
+        auto staged = queue.staged;
+        queue.effect = std::make_shared<reactnativecss::Effect>(
+                [this, rt, staged](reactnativecss::Effect::GetProxy &get) {
+                    (void) get(*staged);
+                    commitRuntime(rt);
+                });
+        // Setup the subscription by doing a dummy get()
+        (void) staged->get(*queue.effect);
+    }
+
+    // Process a single dynamic color value: if string -> call JSI fn (cached), else return as-is.
+    // Without a runtime only cached and natively parsed colors are converted.
+    folly::dynamic ShadowTreeUpdateManager::processColorDynamic(Runtime *runtime,
                                                                 const folly::dynamic &value) {
         if (!value.isString()) {
             return value;
@@ -171,11 +423,22 @@ namespace margelo::nitro::cssnitro {
         if (it != process_color_cache_.end()) {
             return {it->second};
         }
-        if (!process_color_) {
+        // CSS colors are converted natively. Static ones were cached at ingestion, the rest
+        // (e.g. animation frames) are not cached, interpolated colors would grow it without
+        // bound. Only platform colors need the JS processColor.
+        if (auto color = Color::parse(colorStr)) {
+            return {Color::toProcessed(*color)};
+        }
+        if (!process_color_ || runtime == nullptr) {
             return value;
         }
-        jsi::String str = jsi::String::createFromUtf8(runtime, colorStr);
-        jsi::Value result = process_color_->call(runtime, jsi::Value(runtime, str));
+        // processColor lives on the JS runtime, it can't be called from a native thread
+        if (std::this_thread::get_id() != js_thread_id_) {
+            color_deferred_ = true;
+            return value;
+        }
+        jsi::String str = jsi::String::createFromUtf8(*runtime, colorStr);
+        jsi::Value result = process_color_->call(*runtime, jsi::Value(*runtime, str));
         if (!result.isNumber()) {
             return value;
         }
@@ -185,14 +448,11 @@ namespace margelo::nitro::cssnitro {
     }
 
     void
-    ShadowTreeUpdateManager::applyUpdates(Runtime &runtime, const UpdatesMap &updates) {
+    ShadowTreeUpdateManager::applyUpdates(facebook::react::UIManager *uiManager,
+                                          UpdatesMap &&updates) {
         if (updates.empty()) return;
-        auto binding = facebook::react::UIManagerBinding::getBinding(runtime);
-        if (!binding) return;
-        auto &uiManager = binding->getUIManager();
-        // Make a copy since updateShadowTree takes an rvalue reference
-        UpdatesMap updatesCopy = updates;
-        uiManager.updateShadowTree(std::move(updatesCopy));
+        if (uiManager == nullptr) return;
+        uiManager->updateShadowTree(std::move(updates));
     }
 
 } // namespace margelo::nitro::cssnitro
@@ -1,11 +1,18 @@
 #pragma once
 
+#include <functional>
 #include <string>
 #include <memory>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
 #include <folly/dynamic.h>
+#include <NitroModules/AnyMap.hpp>
+#include "AnyValueHash.hpp"
+#include "ComponentTags.hpp"
+#include "ShadowTreeStaging.hpp"
+#include "ViewStyles.hpp"
 #include <react/renderer/core/ReactPrimitives.h>
 
 namespace facebook::jsi {
@@ -21,7 +28,9 @@ namespace reactnativecss {
     class Effect;
 }
 
-namespace margelo::nitro { class AnyMap; }
+namespace facebook::react {
+    class UIManager;
+}
 
 namespace jsi = facebook::jsi;
 
@@ -39,40 +48,164 @@ namespace margelo::nitro::cssnitro {
                            const std::string &componentId,
                            facebook::react::Tag tag);
 
-        bool hasComponent(const std::string &componentId);
+        // Whether the component is linked to a view, updates to others are parked
+        bool isLinked(const std::string &componentId) const;
 
         void unlinkComponent(const std::string &componentId);
 
+        // Unlink the component and forget the style it rendered, e.g. when it is deregistered
+        void removeComponent(const std::string &componentId);
+
+        // The native view tag each linked component is rendered to
+        const ComponentTags<facebook::react::Tag> &tags() const {
+            return tags_;
+        }
+
+        /**
+         * Stage a partial style update for a linked component, e.g. an animation frame.
+         * Only entries that differ from what was last sent to the view are staged. Updates
+         * are merged per view and committed once at the end of the current reactive batch
+         * (immediately outside of one), or earlier through commit(). Updates of components
+         * that aren't linked yet are parked and replayed by linkComponent().
+         */
         void addUpdates(const std::string &componentId,
                         const std::shared_ptr<::margelo::nitro::AnyMap> &styleEntries);
 
+        /**
+         * Stage the full resolved style of a linked component, important entries winning.
+         * Only the keys that changed since the last update are sent, keys that are no
+         * longer set are reset with null. Nothing is staged when nothing changed.
+         */
+        void updateStyle(const std::string &componentId,
+                         const std::shared_ptr<::margelo::nitro::AnyMap> &style,
+                         const std::shared_ptr<::margelo::nitro::AnyMap> &importantStyle);
+
+        // Record the style a render gave the view without staging anything, the view
+        // starts out with it when it is linked
+        void markRendered(const std::string &componentId,
+                          const std::shared_ptr<::margelo::nitro::AnyMap> &style,
+                          const std::shared_ptr<::margelo::nitro::AnyMap> &importantStyle);
+
+        // Apply every staged update now, with one updateShadowTree call per runtime
+        CommitStats commit();
+
+        // The tags and properties of the most recent commit, and how long applying them took
+        const CommitStats &lastCommitStats() const;
+
         void registerProcessColorFunction(jsi::Function &&fn);
 
+        // Runs work on the JS thread, holding the lock the manager is used under
+        using JsDispatch = std::function<void(std::function<void()> &&)>;
+
+        /**
+         * Updates can be staged and committed from native threads. Platform colors there
+         * need the JS processColor, their keys are left out and converted and staged
+         * through dispatch instead. Without one they are sent unconverted.
+         */
+        void setJsDispatch(JsDispatch dispatch);
+
+        /**
+         * Convert the static colors of ingested declarations natively and cache them, so
+         * updates only look them up. Values of keys containing "color" are converted,
+         * nested objects and arrays included.
+         */
+        void precomputeColors(const std::shared_ptr<::margelo::nitro::AnyMap> &declarations);
+
+        // Convert and cache a single value if it is a color, e.g. a variable's value.
+        // Returns whether it was converted natively.
+        bool precomputeColor(const std::string &value);
+
+        /**
+         * Convert the static composite values of ingested style declarations, e.g. transforms
+         * and shadows, to folly::dynamic once, colors included. Updates splice these fragments
+         * in. Scalars and values resolved per component, e.g. variables and units, are
+         * converted per update.
+         */
+        void precomputeFragments(const std::shared_ptr<::margelo::nitro::AnyMap> &declarations);
+
     private:
         friend struct VariantConverter;
         struct ComponentLink {
             facebook::react::Tag tag{0};
             jsi::Runtime *runtime{nullptr};
+            // Entries waiting for the JS processColor. Staging a key again drops its entry,
+            // so a late conversion never overwrites a newer value.
+            ::margelo::nitro::AnyObject deferredColors;
         };
 
         std::shared_ptr<jsi::Function> process_color_;
         std::unordered_map<std::string, int> process_color_cache_;
 
         std::unordered_map<std::string, ComponentLink> component_links_;
+        ComponentTags<facebook::react::Tag> tags_;
 
-        std::unordered_map<jsi::Runtime *, std::shared_ptr<reactnativecss::Observable<UpdatesMap>>> runtime_updates_;
+        // Mounting components are linked right after their first render, few wait at once
+        static constexpr size_t kMaxPendingComponents = 256;
+        ViewStyles views_;
 
-        // Keep one effect per runtime
-        std::unordered_map<jsi::Runtime *, std::shared_ptr<reactnativecss::Effect>> runtime_effects_;
+        // The thread that owns the JS runtime, JSI calls are only made from it
+        std::thread::id js_thread_id_;
+        JsDispatch js_dispatch_;
+        // Set by processColorDynamic when a color needed processColor off the JS thread
+        bool color_deferred_ = false;
+
+        struct DynamicStagingTraits {
+            static void merge(folly::dynamic &into, folly::dynamic &&from);
+
+            static size_t count(const folly::dynamic &payload);
+        };
+
+        // The staged updates of one runtime and the effect committing them. Commits are
+        // coalesced per reactive batch rather than per display frame: the registry wraps each
+        // command flush, state change and animation frame in one batch, so each of those
+        // commits once however many components it touches. A frame-driven flush would need a
+        // display link and would hold staged updates back by up to a frame.
+        struct RuntimeQueue {
+            ShadowTreeStaging<facebook::react::Tag, folly::dynamic, DynamicStagingTraits> staging;
+            // UIManager is resolved on the JS thread and cached, so updates can be applied
+            // from native threads without touching the runtime
+            facebook::react::UIManager *uiManager{nullptr};
+            // Bumped when the first update is staged, the effect commits once per batch
+            std::shared_ptr<reactnativecss::Observable<uint64_t>> staged;
+            std::shared_ptr<reactnativecss::Effect> effect;
+        };
+
+        std::unordered_map<jsi::Runtime *, RuntimeQueue> runtimes_;
+        CommitStats last_commit_;
 
         void ensureRuntimeEffect(jsi::Runtime &runtime);
 
-        static void applyUpdates(jsi::Runtime &runtime, const UpdatesMap &updates);
+        CommitStats commitRuntime(jsi::Runtime *runtime);
+
+        void stageChanges(const std::string &componentId, ComponentLink &link,
+                          const ::margelo::nitro::AnyObject &changes);
+
+        // On the JS thread, convert and stage the colors deferred for a component
+        void stageDeferredColors(const std::string &componentId);
+
+        static ::margelo::nitro::AnyObject
+        mergeStyles(const std::shared_ptr<::margelo::nitro::AnyMap> &style,
+                    const std::shared_ptr<::margelo::nitro::AnyMap> &importantStyle);
+
+        static void applyUpdates(facebook::react::UIManager *uiManager, UpdatesMap &&updates);
+
+        // Returns false when a color of the value couldn't be converted natively
+        bool precomputeColors(const std::string &key, const ::margelo::nitro::AnyValue &value);
+
+        // Distinct values per key are few, past this they are converted per update
+        static constexpr size_t kMaxFragmentsPerKey = 64;
+
+        // The conversions of static composite declaration values by key, then by value. A lookup
+        // hashes the value once and only compares it with values of the same hash.
+        std::unordered_map<std::string,
+                std::unordered_map<::margelo::nitro::AnyValue, folly::dynamic, AnyValueHash>>
+                fragments_;
+
+        const folly::dynamic *findFragment(const std::string &key,
+                                           const ::margelo::nitro::AnyValue &value) const;
 
         // String color processing (with caching)
         folly::dynamic
-        processColorDynamic(jsi::Runtime &runtime, const folly::dynamic &value);
-
-        // styleEntryToUpdate was inlined into addUpdates
+        processColorDynamic(jsi::Runtime *runtime, const folly::dynamic &value);
     };
 } // namespace margelo::nitro::cssnitro
@@ -0,0 +1,42 @@
+#include "StyleDiff.hpp"
+
+#include <variant>
+
+namespace margelo::nitro::cssnitro {
+
+    using ::margelo::nitro::AnyValue;
+
+    AnyObject StyleDiff::full(AnyObject &sent, AnyObject next) {
+        AnyObject changes;
+        for (const auto &entry: next) {
+            auto previous = sent.find(entry.first);
+            if (previous == sent.end() || !(previous->second == entry.second)) {
+                changes[entry.first] = entry.second;
+            }
+        }
+
+        // Removed keys are reset, unless they already were
+        for (const auto &entry: sent) {
+            if (next.count(entry.first) == 0 &&
+                !std::holds_alternative<std::monostate>(entry.second)) {
+                changes[entry.first] = AnyValue();
+            }
+        }
+
+        sent = std::move(next);
+        return changes;
+    }
+
+    AnyObject StyleDiff::partial(AnyObject &sent, const AnyObject &entries) {
+        AnyObject changes;
+        for (const auto &entry: entries) {
+            auto previous = sent.find(entry.first);
+            if (previous == sent.end() || !(previous->second == entry.second)) {
+                changes[entry.first] = entry.second;
+                sent[entry.first] = entry.second;
+            }
+        }
+        return changes;
+    }
+
+} // namespace margelo::nitro::cssnitro
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <NitroModules/AnyMap.hpp>
+
+namespace margelo::nitro::cssnitro {
+
+    using ::margelo::nitro::AnyObject;
+
+    // Tracks the style a view last received so updates only carry what changed
+    class StyleDiff {
+    public:
+        /**
+         * Diff a full style against what was sent and record it as sent.
+         * @return The changed entries, keys that are no longer set are reset with null
+         */
+        static AnyObject full(AnyObject &sent, AnyObject next);
+
+        /**
+         * Diff a partial style, e.g. an animation frame, against what was sent and record
+         * its entries as sent. Keys it doesn't mention are left alone.
+         * @return The changed entries
+         */
+        static AnyObject partial(AnyObject &sent, const AnyObject &entries);
+    };
+
+} // namespace margelo::nitro::cssnitro
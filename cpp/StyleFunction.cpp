@@ -4,43 +4,429 @@
 
 #include "StyleFunction.hpp"
 #include "VariableContext.hpp"
+#include "Environment.hpp"
 #include <NitroModules/AnyMap.hpp>
 
+#include <cmath>
+#include <cstdlib>
+#include <optional>
+#include <sstream>
+
 namespace margelo::nitro::cssnitro {
 
-    AnyValue StyleFunction::resolveStyleFn(
+    namespace {
+
+        // A calc() operand: either a plain number (dp) or a percentage
+        struct CalcValue {
+            double value;
+            bool percent;
+        };
+
+        // Returns the name of a ["fn", name, ...] array, or nullptr if it isn't one
+        const std::string *functionName(const AnyArray &arr) {
+            if (arr.size() < 2 ||
+                !std::holds_alternative<std::string>(arr[0]) ||
+                std::get<std::string>(arr[0]) != "fn" ||
+                !std::holds_alternative<std::string>(arr[1])) {
+                return nullptr;
+            }
+            return &std::get<std::string>(arr[1]);
+        }
+
+        bool isCalcFunction(const std::string &name) {
+            return name == "calc" || name == "sum" || name == "product" || name == "min" ||
+                   name == "max" || name == "clamp" || name == "abs" || name == "sign";
+        }
+
+        // Functions that read the device environment, these are never constant
+        bool isEnvironmentFunction(const std::string &name) {
+            return name == "hairlineWidth" || name == "fontScale" || name == "pixelScale" ||
+                   name == "roundToNearestPixel" || name == "getPixelSizeForLayoutSize";
+        }
+
+        // Returns the unit of a [{}, unit, value, ...] array, or nullptr if it isn't one
+        const std::string *unitName(const AnyArray &arr) {
+            if (arr.size() < 3 ||
+                !std::holds_alternative<AnyObject>(arr[0]) ||
+                !std::holds_alternative<std::string>(arr[1])) {
+                return nullptr;
+            }
+            return &std::get<std::string>(arr[1]);
+        }
+
+        AnyValue toAnyValue(const CalcValue &result) {
+            if (!result.percent) {
+                return AnyValue(result.value);
+            }
+
+            std::ostringstream stream;
+            stream.precision(10);
+            stream << result.value << '%';
+            return AnyValue(stream.str());
+        }
+
+        std::optional<CalcValue> add(const CalcValue &left, const CalcValue &right) {
+            // Mixed lengths and percentages can only be resolved against layout
+            if (left.percent != right.percent) {
+                return std::nullopt;
+            }
+            return CalcValue{left.value + right.value, left.percent};
+        }
+
+        std::optional<CalcValue> multiply(const CalcValue &left, const CalcValue &right) {
+            if (left.percent && right.percent) {
+                return std::nullopt;
+            }
+            return CalcValue{left.value * right.value, left.percent || right.percent};
+        }
+
+        /**
+         * Evaluates the calc() family of functions emitted by the compiler.
+         * Without a GetProxy only constant expressions can be evaluated; any dynamic
+         * leaf (e.g. var()) makes the evaluation fail.
+         */
+        class CalcEvaluator {
+        public:
+            CalcEvaluator(reactnativecss::Effect::GetProxy *get, const std::string &variableScope)
+                    : get_(get), variableScope_(variableScope) {}
+
+            std::optional<CalcValue> evaluate(const AnyValue &value) {
+                if (std::holds_alternative<double>(value)) {
+                    return CalcValue{std::get<double>(value), false};
+                }
+
+                if (std::holds_alternative<int64_t>(value)) {
+                    return CalcValue{static_cast<double>(std::get<int64_t>(value)), false};
+                }
+
+                if (std::holds_alternative<std::string>(value)) {
+                    // Percentages are emitted as strings, e.g. "50%"
+                    const auto &str = std::get<std::string>(value);
+                    if (str.size() < 2 || str.back() != '%') {
+                        return std::nullopt;
+                    }
+                    char *end = nullptr;
+                    double number = std::strtod(str.c_str(), &end);
+                    if (end != str.c_str() + str.size() - 1) {
+                        return std::nullopt;
+                    }
+                    return CalcValue{number, true};
+                }
+
+                if (std::holds_alternative<AnyArray>(value)) {
+                    return evaluate(std::get<AnyArray>(value));
+                }
+
+                return std::nullopt;
+            }
+
+            std::optional<CalcValue> evaluate(const AnyArray &arr) {
+                if (const std::string *unit = unitName(arr)) {
+                    return evaluateUnit(*unit, arr);
+                }
+
+                const std::string *name = functionName(arr);
+                if (name == nullptr) {
+                    return std::nullopt;
+                }
+                if (*name == "var") {
+                    return evaluateVar(arr);
+                }
+                if (isCalcFunction(*name)) {
+                    return evaluateFunction(*name, arr);
+                }
+                if (isEnvironmentFunction(*name)) {
+                    return evaluateEnvironmentFunction(*name, arr);
+                }
+                return std::nullopt;
+            }
+
+        private:
+            std::optional<CalcValue> evaluateVar(const AnyArray &fnArgs) {
+                // Variables are dynamic, they can't be folded
+                if (get_ == nullptr) {
+                    return std::nullopt;
+                }
+
+                auto resolved = StyleFunction::resolveStyleFn(fnArgs, *get_, variableScope_);
+                if (!resolved) {
+                    return std::nullopt;
+                }
+                return evaluate(*resolved);
+            }
+
+            // [{}, "rem", v], [{}, "vw" | "vh" | "em", v, 1]
+            std::optional<CalcValue> evaluateUnit(const std::string &unit, const AnyArray &unitArgs) {
+                // Units are bound to the environment, they can't be folded
+                if (get_ == nullptr || !std::holds_alternative<double>(unitArgs[2])) {
+                    return std::nullopt;
+                }
+
+                auto &get = *get_;
+                double value = std::get<double>(unitArgs[2]);
+
+                if (unit == "rem") {
+                    return CalcValue{value * get(reactnativecss::env::rem()), false};
+                }
+                if (unit == "vw") {
+                    return CalcValue{value * get(reactnativecss::env::vw()), false};
+                }
+                if (unit == "vh") {
+                    return CalcValue{value * get(reactnativecss::env::vh()), false};
+                }
+                if (unit == "em") {
+                    // em is relative to the inherited font size, falling back to rem
+                    auto fontSize = VariableContext::getVariable(variableScope_, "__rn-css-em", get);
+                    if (fontSize && std::holds_alternative<double>(*fontSize)) {
+                        return CalcValue{value * std::get<double>(*fontSize), false};
+                    }
+                    return CalcValue{value * get(reactnativecss::env::rem()), false};
+                }
+
+                return std::nullopt;
+            }
+
+            std::optional<CalcValue> evaluateEnvironmentFunction(const std::string &name,
+                                                                 const AnyArray &fnArgs) {
+                if (get_ == nullptr) {
+                    return std::nullopt;
+                }
+
+                auto &get = *get_;
+                double scale = get(reactnativecss::env::windowScale());
+                if (scale <= 0.0) {
+                    scale = 1.0;
+                }
+
+                if (name == "hairlineWidth") {
+                    // Matches StyleSheet.hairlineWidth: 0.4 rounded to the nearest pixel
+                    double width = std::round(0.4 * scale) / scale;
+                    return CalcValue{width > 0.0 ? width : 1.0 / scale, false};
+                }
+
+                // The remaining functions take an optional (fontScale, pixelScale) or required
+                // numeric argument
+                std::optional<CalcValue> argument;
+                if (fnArgs.size() > 2) {
+                    argument = evaluate(fnArgs[2]);
+                    if (!argument || argument->percent) {
+                        return std::nullopt;
+                    }
+                }
+
+                if (name == "fontScale" || name == "pixelScale") {
+                    double factor = name == "fontScale"
+                                    ? get(reactnativecss::env::windowFontScale())
+                                    : scale;
+                    return CalcValue{factor * (argument ? argument->value : 1.0), false};
+                }
+
+                if (!argument) {
+                    return std::nullopt;
+                }
+                if (name == "roundToNearestPixel") {
+                    return CalcValue{std::round(argument->value * scale) / scale, false};
+                }
+                // getPixelSizeForLayoutSize
+                return CalcValue{std::round(argument->value * scale), false};
+            }
+
+            std::optional<CalcValue> evaluateFunction(const std::string &name,
+                                                      const AnyArray &fnArgs) {
+                // Arguments start after ["fn", name]
+                const size_t argc = fnArgs.size() - 2;
+                auto arg = [&](size_t index) { return evaluate(fnArgs[index + 2]); };
+
+                if (name == "calc") {
+                    if (argc == 1) {
+                        return arg(0);
+                    }
+                    // The compiler spreads an array argument into calc's own array, e.g.
+                    // calc(100% - 10px) is ["fn", "calc", "fn", "sum", "100%", -10]
+                    return evaluate(AnyArray(fnArgs.begin() + 2, fnArgs.end()));
+                }
+
+                if (name == "sum" || name == "product") {
+                    if (argc != 2) {
+                        return std::nullopt;
+                    }
+                    auto left = arg(0);
+                    auto right = arg(1);
+                    if (!left || !right) {
+                        return std::nullopt;
+                    }
+                    return name == "sum" ? add(*left, *right) : multiply(*left, *right);
+                }
+
+                if (name == "min" || name == "max") {
+                    if (argc == 0) {
+                        return std::nullopt;
+                    }
+                    auto result = arg(0);
+                    for (size_t i = 1; result && i < argc; i++) {
+                        auto next = arg(i);
+                        if (!next || next->percent != result->percent) {
+                            return std::nullopt;
+                        }
+                        result->value = name == "min" ? std::min(result->value, next->value)
+                                                      : std::max(result->value, next->value);
+                    }
+                    return result;
+                }
+
+                if (name == "clamp") {
+                    if (argc != 3) {
+                        return std::nullopt;
+                    }
+                    auto lower = arg(0);
+                    auto value = arg(1);
+                    auto upper = arg(2);
+                    if (!lower || !value || !upper || lower->percent != value->percent ||
+                        upper->percent != value->percent) {
+                        return std::nullopt;
+                    }
+                    // The lower bound wins when the bounds cross
+                    value->value = std::max(lower->value, std::min(value->value, upper->value));
+                    return value;
+                }
+
+                if (name == "abs" || name == "sign") {
+                    if (argc != 1) {
+                        return std::nullopt;
+                    }
+                    auto value = arg(0);
+                    if (!value) {
+                        return std::nullopt;
+                    }
+                    if (name == "abs") {
+                        return CalcValue{std::fabs(value->value), value->percent};
+                    }
+                    return CalcValue{static_cast<double>((value->value > 0) - (value->value < 0)),
+                                     false};
+                }
+
+                return std::nullopt;
+            }
+
+            reactnativecss::Effect::GetProxy *get_;
+            const std::string &variableScope_;
+        };
+
+        AnyValue foldValue(const AnyValue &value, bool &changed) {
+            if (std::holds_alternative<AnyObject>(value)) {
+                const auto &obj = std::get<AnyObject>(value);
+                AnyObject folded;
+                bool objectChanged = false;
+                for (const auto &[key, entry]: obj) {
+                    folded[key] = foldValue(entry, objectChanged);
+                }
+                if (!objectChanged) {
+                    return value;
+                }
+                changed = true;
+                return AnyValue(std::move(folded));
+            }
+
+            if (!std::holds_alternative<AnyArray>(value)) {
+                return value;
+            }
+
+            const auto &arr = std::get<AnyArray>(value);
+            const std::string *name = functionName(arr);
+
+            // A fully constant expression is replaced by its result
+            if (name != nullptr && isCalcFunction(*name)) {
+                static const std::string noScope;
+                CalcEvaluator evaluator(nullptr, noScope);
+                auto result = evaluator.evaluate(arr);
+                if (result) {
+                    changed = true;
+                    return toAnyValue(*result);
+                }
+            }
+
+            // Otherwise fold the constant subexpressions, keeping the dynamic leaves
+            AnyArray folded;
+            folded.reserve(arr.size());
+            bool arrayChanged = false;
+            for (const auto &entry: arr) {
+                folded.push_back(foldValue(entry, arrayChanged));
+            }
+            if (!arrayChanged) {
+                return value;
+            }
+            changed = true;
+            return AnyValue(std::move(folded));
+        }
+
+    } // namespace
+
+    AnyValuePtr StyleFunction::resolveStyleFn(
             const AnyArray &fnArgs,
             typename reactnativecss::Effect::GetProxy &get,
             const std::string &variableScope
     ) {
-        // Check if fnArgs has at least 3 elements and first is "fn"
-        if (fnArgs.size() >= 3 &&
-            std::holds_alternative<std::string>(fnArgs[0]) &&
-            std::get<std::string>(fnArgs[0]) == "fn") {
-
-            // Check if second element is "var"
-            if (std::holds_alternative<std::string>(fnArgs[1]) &&
-                std::get<std::string>(fnArgs[1]) == "var") {
-
-                // Need at least ["fn", "var", name]
-                if (fnArgs.size() >= 3 && std::holds_alternative<std::string>(fnArgs[2])) {
-                    const std::string &varName = std::get<std::string>(fnArgs[2]);
-
-                    // Get fallback value (if exists, it's at index 3)
-                    AnyValue fallback;
-                    if (fnArgs.size() >= 4) {
-                        fallback = fnArgs[3];
-                    }
+        const std::string *name = functionName(fnArgs);
+        if (name == nullptr) {
+            return nullptr;
+        }
 
-                    return resolveVar(varName, fallback, get, variableScope);
+        // Check if second element is "var"
+        if (*name == "var") {
+            // Need at least ["fn", "var", name]
+            if (fnArgs.size() >= 3 && std::holds_alternative<std::string>(fnArgs[2])) {
+                const std::string &varName = std::get<std::string>(fnArgs[2]);
+
+                // Get fallback value (if exists, it's at index 3)
+                AnyValue fallback;
+                if (fnArgs.size() >= 4) {
+                    fallback = fnArgs[3];
                 }
+
+                return resolveVar(varName, fallback, get, variableScope);
+            }
+            return nullptr;
+        }
+
+        // calc() and friends are evaluated natively, subscribing to any var() or environment leaves
+        if (isCalcFunction(*name) || isEnvironmentFunction(*name)) {
+            CalcEvaluator evaluator(&get, variableScope);
+            auto result = evaluator.evaluate(fnArgs);
+            if (result) {
+                return std::make_shared<const AnyValue>(toAnyValue(*result));
+            }
+        }
+
+        return nullptr;
+    }
+
+    AnyValuePtr StyleFunction::resolveUnit(
+            const AnyArray &unitArgs,
+            typename reactnativecss::Effect::GetProxy &get,
+            const std::string &variableScope
+    ) {
+        const std::string *unit = unitName(unitArgs);
+        if (unit == nullptr) {
+            return nullptr;
+        }
+
+        // [{}, "var", name] references a variable directly, e.g. currentcolor
+        if (*unit == "var") {
+            if (!std::holds_alternative<std::string>(unitArgs[2])) {
+                return nullptr;
             }
+            return resolveVar(std::get<std::string>(unitArgs[2]), AnyValue(), get, variableScope);
         }
 
-        return AnyValue();
+        CalcEvaluator evaluator(&get, variableScope);
+        auto result = evaluator.evaluate(unitArgs);
+        if (result) {
+            return std::make_shared<const AnyValue>(toAnyValue(*result));
+        }
+        return nullptr;
     }
 
-    AnyValue StyleFunction::resolveVar(
+    AnyValuePtr StyleFunction::resolveVar(
             const std::string &name,
             const AnyValue &fallback,
             typename reactnativecss::Effect::GetProxy &get,
@@ -48,14 +434,14 @@ namespace margelo::nitro::cssnitro {
     ) {
         auto result = VariableContext::getVariable(variableScope, name, get);
 
-        if (result.has_value()) {
-            return result.value();
+        if (result) {
+            return result;
         }
 
         return resolveAnyValue(fallback, get, variableScope);
     }
 
-    AnyValue StyleFunction::resolveAnyValue(
+    AnyValuePtr StyleFunction::resolveAnyValue(
             const AnyValue &value,
             typename reactnativecss::Effect::GetProxy &get,
             const std::string &variableScope
@@ -66,8 +452,40 @@ namespace margelo::nitro::cssnitro {
             return resolveStyleFn(arr, get, variableScope);
         }
 
+        if (std::holds_alternative<std::monostate>(value)) {
+            return nullptr;
+        }
+
         // Return the value as-is if it's not an array
-        return value;
+        return std::make_shared<const AnyValue>(value);
+    }
+
+    std::shared_ptr<AnyMap> StyleFunction::foldConstants(const std::shared_ptr<AnyMap> &declarations) {
+        if (!declarations) {
+            return declarations;
+        }
+
+        const auto &map = declarations->getMap();
+        std::shared_ptr<AnyMap> folded;
+
+        for (const auto &[key, value]: map) {
+            bool changed = false;
+            AnyValue foldedValue = foldValue(value, changed);
+            if (!changed) {
+                continue;
+            }
+
+            // Only copy the map once something has actually been folded
+            if (!folded) {
+                folded = AnyMap::make(map.size());
+                for (const auto &entry: map) {
+                    folded->setAny(entry.first, entry.second);
+                }
+            }
+            folded->setAny(key, foldedValue);
+        }
+
+        return folded ? folded : declarations;
     }
 
 } // namespace margelo::nitro::cssnitro
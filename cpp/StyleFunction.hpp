@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -14,12 +15,21 @@ namespace margelo::nitro {
     struct AnyValue;
     using AnyArray = std::vector<AnyValue>;
     using AnyObject = std::unordered_map<std::string, AnyValue>;
+    class AnyMap;
 }
 
 namespace margelo::nitro::cssnitro {
 
     using AnyValue = ::margelo::nitro::AnyValue;
     using AnyArray = ::margelo::nitro::AnyArray;
+    using AnyMap = ::margelo::nitro::AnyMap;
+
+    /**
+     * An immutable, shared style value. Resolved variables are handed out as these so that
+     * reading a large value (e.g. a shadow or gradient array) is a pointer copy.
+     * nullptr means the value could not be resolved.
+     */
+    using AnyValuePtr = std::shared_ptr<const AnyValue>;
 
     class StyleFunction {
     public:
@@ -29,14 +39,29 @@ namespace margelo::nitro::cssnitro {
          * @param fnArgs The arguments array (first element should be the function name)
          * @param get The Effect::GetProxy for reactive dependencies
          * @param variableScope The variable scope context for resolving variables
-         * @return The resolved style value
+         * @return The resolved style value, or nullptr if it could not be resolved
          */
-        static AnyValue resolveStyleFn(
+        static AnyValuePtr resolveStyleFn(
                 const AnyArray &fnArgs,
                 typename reactnativecss::Effect::GetProxy &get,
                 const std::string &variableScope
         );
 
+        /**
+         * Resolve a unit value, e.g. [{}, "rem", 2] or [{}, "vw", 50, 1], against the
+         * environment. [{}, "var", name] resolves the variable directly.
+         *
+         * @param unitArgs The unit array (first element is an empty object)
+         * @param get The Effect::GetProxy for reactive dependencies
+         * @param variableScope The variable scope context for resolving variables
+         * @return The resolved value, or nullptr if it could not be resolved
+         */
+        static AnyValuePtr resolveUnit(
+                const AnyArray &unitArgs,
+                typename reactnativecss::Effect::GetProxy &get,
+                const std::string &variableScope
+        );
+
         /**
          * Resolve a CSS variable from the variable context.
          *
@@ -44,9 +69,9 @@ namespace margelo::nitro::cssnitro {
          * @param fallback The fallback value if the variable is not found
          * @param get The Effect::GetProxy for reactive dependencies
          * @param variableScope The variable scope context for resolving variables
-         * @return The resolved variable value or fallback
+         * @return The resolved variable value or fallback, or nullptr if neither resolves
          */
-        static AnyValue resolveVar(
+        static AnyValuePtr resolveVar(
                 const std::string &name,
                 const AnyValue &fallback,
                 typename reactnativecss::Effect::GetProxy &get,
@@ -59,13 +84,22 @@ namespace margelo::nitro::cssnitro {
          * @param value The value to resolve
          * @param get The Effect::GetProxy for reactive dependencies
          * @param variableScope The variable scope context for resolving variables
-         * @return The resolved value
+         * @return The resolved value, or nullptr if it could not be resolved
          */
-        static AnyValue resolveAnyValue(
+        static AnyValuePtr resolveAnyValue(
                 const AnyValue &value,
                 typename reactnativecss::Effect::GetProxy &get,
                 const std::string &variableScope
         );
+
+        /**
+         * Fold the constant calc(), min(), max(), clamp(), abs() and sign() subexpressions
+         * of a declarations map. Only the dynamic leaves (e.g. var()) are left to resolve.
+         *
+         * @param declarations The declarations to fold
+         * @return A new map with folded values, or declarations itself if nothing was folded
+         */
+        static std::shared_ptr<AnyMap> foldConstants(const std::shared_ptr<AnyMap> &declarations);
     };
 
 } // namespace margelo::nitro::cssnitro
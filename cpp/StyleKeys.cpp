@@ -0,0 +1,76 @@
+#include "StyleKeys.hpp"
+
+#include <cctype>
+#include <unordered_map>
+
+namespace margelo::nitro::cssnitro {
+
+    // The React Native style keys, built once
+    static const std::unordered_map<std::string, StyleKeyKind> &knownKeys() {
+        static const std::unordered_map<std::string, StyleKeyKind> keys = [] {
+            std::unordered_map<std::string, StyleKeyKind> table;
+            for (const char *key: {
+                    "color", "backgroundColor", "borderColor", "borderTopColor",
+                    "borderRightColor", "borderBottomColor", "borderLeftColor",
+                    "borderStartColor", "borderEndColor", "borderBlockColor",
+                    "borderBlockStartColor", "borderBlockEndColor", "outlineColor",
+                    "shadowColor", "textShadowColor", "textDecorationColor", "tintColor",
+                    "overlayColor", "placeholderTextColor", "selectionColor", "cursorColor",
+                    "caretColor", "underlineColorAndroid"}) {
+                table.emplace(key, StyleKeyKind::Color);
+            }
+            table.emplace("transform", StyleKeyKind::Transform);
+            for (const char *key: {
+                    "width", "height", "minWidth", "minHeight", "maxWidth", "maxHeight",
+                    "top", "right", "bottom", "left", "start", "end",
+                    "inset", "insetBlock", "insetBlockStart", "insetBlockEnd",
+                    "insetInline", "insetInlineStart", "insetInlineEnd",
+                    "margin", "marginTop", "marginRight", "marginBottom", "marginLeft",
+                    "marginStart", "marginEnd", "marginHorizontal", "marginVertical",
+                    "marginBlock", "marginBlockStart", "marginBlockEnd",
+                    "marginInline", "marginInlineStart", "marginInlineEnd",
+                    "padding", "paddingTop", "paddingRight", "paddingBottom", "paddingLeft",
+                    "paddingStart", "paddingEnd", "paddingHorizontal", "paddingVertical",
+                    "paddingBlock", "paddingBlockStart", "paddingBlockEnd",
+                    "paddingInline", "paddingInlineStart", "paddingInlineEnd",
+                    "gap", "rowGap", "columnGap", "flexBasis",
+                    "borderWidth", "borderTopWidth", "borderRightWidth", "borderBottomWidth",
+                    "borderLeftWidth", "borderStartWidth", "borderEndWidth",
+                    "borderRadius", "borderTopLeftRadius", "borderTopRightRadius",
+                    "borderBottomLeftRadius", "borderBottomRightRadius",
+                    "borderTopStartRadius", "borderTopEndRadius",
+                    "borderBottomStartRadius", "borderBottomEndRadius",
+                    "outlineWidth", "outlineOffset", "fontSize", "lineHeight",
+                    "letterSpacing", "shadowRadius", "textShadowRadius", "elevation"}) {
+                table.emplace(key, StyleKeyKind::Dimension);
+            }
+            return table;
+        }();
+        return keys;
+    }
+
+    static bool containsColorInsensitive(const std::string &key) {
+        static const char needle[] = "color";
+        constexpr size_t needleSize = sizeof(needle) - 1;
+        if (key.size() < needleSize) return false;
+        for (size_t i = 0; i + needleSize <= key.size(); i++) {
+            size_t j = 0;
+            while (j < needleSize &&
+                   ::tolower(static_cast<unsigned char>(key[i + j])) == needle[j]) {
+                j++;
+            }
+            if (j == needleSize) return true;
+        }
+        return false;
+    }
+
+    StyleKeyKind StyleKeys::classify(const std::string &key) {
+        const auto &known = knownKeys();
+        auto it = known.find(key);
+        if (it != known.end()) {
+            return it->second;
+        }
+        return containsColorInsensitive(key) ? StyleKeyKind::Color : StyleKeyKind::Passthrough;
+    }
+
+} // namespace margelo::nitro::cssnitro
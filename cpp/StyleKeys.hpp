@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace margelo::nitro::cssnitro {
+
+    // How the value of a style key is converted for the shadow tree
+    enum class StyleKeyKind : uint8_t {
+        Passthrough,
+        Color,     // strings go through processColor
+        Transform, // a list of single-key transform objects, e.g. [{translateX: 10}]
+        Dimension, // a number or a percentage string, never a color
+    };
+
+    class StyleKeys {
+    public:
+        /**
+         * Classify a style key. Known React Native keys come from a static table, others
+         * fall back to a case-insensitive search for "color". Neither path allocates.
+         */
+        static StyleKeyKind classify(const std::string &key);
+
+        static bool isColor(const std::string &key) {
+            return classify(key) == StyleKeyKind::Color;
+        }
+    };
+
+} // namespace margelo::nitro::cssnitro
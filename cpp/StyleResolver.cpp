@@ -12,11 +12,14 @@ namespace margelo::nitro::cssnitro {
 
     using AnyObject = ::margelo::nitro::AnyObject;
 
-    AnyValue StyleResolver::resolveStyle(
+    const AnyValue &StyleResolver::resolveStyle(
             const AnyValue &value,
             const std::string &variableScope,
-            typename reactnativecss::Effect::GetProxy &get
+            typename reactnativecss::Effect::GetProxy &get,
+            AnyValuePtr &holder
     ) {
+        static const AnyValue unresolved;
+
         // Check if value is an array
         if (std::holds_alternative<AnyArray>(value)) {
             const auto &arr = std::get<AnyArray>(value);
@@ -27,7 +30,17 @@ namespace margelo::nitro::cssnitro {
                 std::get<std::string>(arr[0]) == "fn") {
 
                 // Resolve the function
-                return StyleFunction::resolveStyleFn(arr, get, variableScope);
+                holder = StyleFunction::resolveStyleFn(arr, get, variableScope);
+                return holder ? *holder : unresolved;
+            }
+
+            // Unit values start with an empty object and the unit, e.g. [{}, "rem", 2].
+            // Other arrays of objects (shadows, transforms) are plain values.
+            if (arr.size() >= 3 && std::holds_alternative<AnyObject>(arr[0]) &&
+                std::get<AnyObject>(arr[0]).empty() &&
+                std::holds_alternative<std::string>(arr[1])) {
+                holder = StyleFunction::resolveUnit(arr, get, variableScope);
+                return holder ? *holder : unresolved;
             }
         }
 
@@ -35,8 +48,18 @@ namespace margelo::nitro::cssnitro {
         return value;
     }
 
-    std::shared_ptr<AnyMap> StyleResolver::applyStyleMapping(
-            const std::unordered_map<std::string, AnyValue> &inputMap,
+    // Style maps hold values or shared values, mapStyles reads both the same way
+    static const AnyValue &styleValue(const AnyValue &value) {
+        return value;
+    }
+
+    static const AnyValue &styleValue(const AnyValuePtr &value) {
+        return *value;
+    }
+
+    template<typename Value>
+    static std::shared_ptr<AnyMap> mapStyles(
+            const std::unordered_map<std::string, Value> &inputMap,
             const std::string &variableScope,
             typename reactnativecss::Effect::GetProxy &get,
             bool processAnimations
@@ -51,21 +74,24 @@ namespace margelo::nitro::cssnitro {
 
         auto anyMap = AnyMap::make(inputMap.size());
 
-        for (const auto &kv: inputMap) {
+        for (const auto &entry: inputMap) {
+            const std::string &key = entry.first;
+            const AnyValue &value = styleValue(entry.second);
+
             // Handle animationName property only if processAnimations is true
-            if (processAnimations && kv.first == "animationName") {
+            if (processAnimations && key == "animationName") {
                 // animationName can be a string or a vector of strings
-                if (std::holds_alternative<std::string>(kv.second)) {
+                if (std::holds_alternative<std::string>(value)) {
                     // Single animation name
-                    const std::string &animName = std::get<std::string>(kv.second);
+                    const std::string &animName = std::get<std::string>(value);
                     auto keyframes = reactnativecss::animations::getKeyframes(animName,
                                                                               variableScope, get);
 
                     // Set animationName to the resolved keyframes object
                     anyMap->setObject("animationName", keyframes->getMap());
-                } else if (std::holds_alternative<AnyArray>(kv.second)) {
+                } else if (std::holds_alternative<AnyArray>(value)) {
                     // Array of animation names
-                    const AnyArray &animNames = std::get<AnyArray>(kv.second);
+                    const AnyArray &animNames = std::get<AnyArray>(value);
                     AnyArray keyframesArray;
 
                     for (const auto &animNameValue: animNames) {
@@ -82,13 +108,13 @@ namespace margelo::nitro::cssnitro {
                     anyMap->setArray("animationName", keyframesArray);
                 } else {
                     // Invalid type for animationName, just pass through as-is
-                    anyMap->setAny("animationName", kv.second);
+                    anyMap->setAny("animationName", value);
                 }
                 continue;
             }
 
             // Handle transform properties
-            if (transformProps.count(kv.first) > 0) {
+            if (transformProps.count(key) > 0) {
                 AnyArray transformArray;
 
                 // Get existing transform array if it exists
@@ -96,13 +122,13 @@ namespace margelo::nitro::cssnitro {
                     transformArray = anyMap->getArray("transform");
                 }
 
-                // Find the value in the array with the key matching kv.first and set it to kv.second
+                // Find the transform entry for this key and set its value
                 bool foundTransform = false;
                 for (size_t i = 0; i < transformArray.size(); i++) {
                     if (std::holds_alternative<AnyObject>(transformArray[i])) {
                         auto obj = std::get<AnyObject>(transformArray[i]);
-                        if (obj.count(kv.first) > 0) {
-                            obj[kv.first] = kv.second;
+                        if (obj.count(key) > 0) {
+                            obj[key] = value;
                             transformArray[i] = obj;
                             foundTransform = true;
                             break;
@@ -113,7 +139,7 @@ namespace margelo::nitro::cssnitro {
                 // If transform property not found in array, add a new transform object
                 if (!foundTransform) {
                     AnyObject transformObj;
-                    transformObj[kv.first] = kv.second;
+                    transformObj[key] = value;
                     transformArray.emplace_back(transformObj);
                 }
 
@@ -122,10 +148,28 @@ namespace margelo::nitro::cssnitro {
             }
 
             // For all other properties, just pass through as-is
-            anyMap->setAny(kv.first, kv.second);
+            anyMap->setAny(key, value);
         }
 
         return anyMap;
     }
 
+    std::shared_ptr<AnyMap> StyleResolver::applyStyleMapping(
+            const std::unordered_map<std::string, AnyValue> &inputMap,
+            const std::string &variableScope,
+            typename reactnativecss::Effect::GetProxy &get,
+            bool processAnimations
+    ) {
+        return mapStyles(inputMap, variableScope, get, processAnimations);
+    }
+
+    std::shared_ptr<AnyMap> StyleResolver::applyStyleMapping(
+            const std::unordered_map<std::string, AnyValuePtr> &inputMap,
+            const std::string &variableScope,
+            typename reactnativecss::Effect::GetProxy &get,
+            bool processAnimations
+    ) {
+        return mapStyles(inputMap, variableScope, get, processAnimations);
+    }
+
 } // namespace margelo::nitro::cssnitro
@@ -6,6 +6,7 @@
 
 #include <string>
 #include "Effect.hpp"
+#include "StyleFunction.hpp"
 #include <NitroModules/AnyMap.hpp>
 #include <unordered_map>
 
@@ -28,12 +29,15 @@ namespace margelo::nitro::cssnitro {
          * @param value The value to resolve
          * @param variableScope The variable scope context for resolving variables
          * @param get The Effect::GetProxy for reactive dependencies
-         * @return The resolved style value
+         * @param holder Keeps a resolved function result alive; the returned reference
+         *               points either into it or into value
+         * @return The resolved style value, monostate if it could not be resolved
          */
-        static AnyValue resolveStyle(
+        static const AnyValue &resolveStyle(
                 const AnyValue &value,
                 const std::string &variableScope,
-                typename reactnativecss::Effect::GetProxy &get
+                typename reactnativecss::Effect::GetProxy &get,
+                AnyValuePtr &holder
         );
 
         /**
@@ -53,6 +57,17 @@ namespace margelo::nitro::cssnitro {
                 typename reactnativecss::Effect::GetProxy &get,
                 bool processAnimations = true
         );
+
+        /**
+         * Apply style mapping to a map of shared style values, see above. The values are
+         * only copied into the returned AnyMap.
+         */
+        static std::shared_ptr<AnyMap> applyStyleMapping(
+                const std::unordered_map<std::string, AnyValuePtr> &inputMap,
+                const std::string &variableScope,
+                typename reactnativecss::Effect::GetProxy &get,
+                bool processAnimations = true
+        );
     };
 
 } // namespace margelo::nitro::cssnitro
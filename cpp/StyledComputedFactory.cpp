@@ -7,6 +7,7 @@
 #include "Specificity.hpp"
 #include "StyleResolver.hpp"
 #include "VariableContext.hpp"
+#include "Animations.hpp"
 
 #include <regex>
 #include <variant>
@@ -19,34 +20,59 @@
 namespace margelo::nitro::cssnitro {
 
     using AnyMap = ::margelo::nitro::AnyMap;
+    using AnyObject = ::margelo::nitro::AnyObject;
 
 
-    std::shared_ptr<reactnativecss::Computed<Styled *>> makeStyledComputed(
+    // Two matched rule sets are equal when they hold the same rules, with the same payloads
+    static bool sameRules(const MatchedRules &a, const MatchedRules &b) {
+        if (a == b) {
+            return true;
+        }
+        if (!a || !b || a->size() != b->size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a->size(); i++) {
+            const auto &left = (*a)[i];
+            const auto &right = (*b)[i];
+            if (left.id != right.id || left.s != right.s || left.d != right.d ||
+                left.p != right.p || left.v != right.v) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Two optional style or prop maps are equal when they hold the same entries
+    static bool sameEntries(const std::optional<std::shared_ptr<AnyMap>> &a,
+                            const std::optional<std::shared_ptr<AnyMap>> &b) {
+        const AnyMap *left = a.has_value() ? a.value().get() : nullptr;
+        const AnyMap *right = b.has_value() ? b.value().get() : nullptr;
+        if (left == right) {
+            return true;
+        }
+        if (left == nullptr || right == nullptr) {
+            return false;
+        }
+        return left->getMap() == right->getMap();
+    }
+
+    std::shared_ptr<reactnativecss::Effect> makeMatchedRulesEffect(
             const std::unordered_map<std::string, std::shared_ptr<reactnativecss::Observable<std::vector<HybridStyleRule>>>> &styleRuleMap,
             const std::string &classNames,
             const std::string &componentId,
-            const std::function<void()> &rerender,
-            ShadowTreeUpdateManager &shadowUpdates,
             const std::string &variableScope,
             const std::string &containerScope,
-            const std::vector<std::string> &validAttributeQueries) {
+            const std::vector<std::string> &validAttributeQueries,
+            const std::shared_ptr<reactnativecss::Observable<MatchedRules>> &matchedRules) {
 
-        // Capture rerender by value (copy) so it persists through fast refresh
-        // Capture shadowUpdates by pointer since it's a stable singleton
-        auto shadowUpdatesPtr = &shadowUpdates;
+        // The inline variables last written to variableScope by this effect
+        auto committed = std::make_shared<std::unordered_map<std::string, AnyValue>>();
 
-        auto computed = reactnativecss::Computed<Styled *>::create(
-                [&styleRuleMap, classNames, componentId, rerender, shadowUpdatesPtr, variableScope, containerScope, validAttributeQueries](
-                        Styled *const &prev,
+        return std::make_shared<reactnativecss::Effect>(
+                [&styleRuleMap, classNames, componentId, variableScope, containerScope, validAttributeQueries, matchedRules, committed](
                         typename reactnativecss::Effect::GetProxy &get) {
-                    Styled *next = new Styled{};
-                    std::unordered_map<std::string, AnyValue> mergedStyles;
-                    std::unordered_map<std::string, AnyValue> mergedProps;
-                    std::unordered_map<std::string, AnyValue> mergedImportantStyles;
-                    std::unordered_map<std::string, AnyValue> mergedImportantProps;
-
                     // Collect all style rules from all classNames
-                    std::vector<HybridStyleRule> allStyleRules;
+                    auto allStyleRules = std::make_shared<std::vector<HybridStyleRule>>();
 
                     std::regex whitespace{"\\s+"};
                     std::sregex_token_iterator tokenIt(classNames.begin(), classNames.end(),
@@ -70,27 +96,83 @@ namespace margelo::nitro::cssnitro {
                         for (const HybridStyleRule &styleRule: styleRules) {
                             if (Rules::testRule(styleRule, get, componentId, containerScope,
                                                 validAttributeQueries)) {
-                                allStyleRules.push_back(styleRule);
+                                allStyleRules->push_back(styleRule);
                             }
                         }
                     }
 
                     // Sort all style rules by specificity (highest specificity first)
-                    std::sort(allStyleRules.begin(), allStyleRules.end(),
+                    std::sort(allStyleRules->begin(), allStyleRules->end(),
                               [](const HybridStyleRule &a, const HybridStyleRule &b) {
                                   return Specificity::sort(a.s, b.s);
                               });
 
-                    // Process the inline variables
-                    for (const HybridStyleRule &styleRule: allStyleRules) {
-                        if (styleRule.v.has_value()) {
-                            const auto &inlineVariables = styleRule.v.value();
-                            for (const auto &kv: inlineVariables->getMap()) {
+                    // Collect the inline variables, the most specific definition wins
+                    std::unordered_map<std::string, AnyValue> variables;
+                    for (const HybridStyleRule &styleRule: *allStyleRules) {
+                        if (styleRule.v.has_value() && styleRule.v.value()) {
+                            for (const auto &kv: styleRule.v.value()->getMap()) {
+                                variables.emplace(kv.first, kv.second);
+                            }
+                        }
+                    }
+
+                    MatchedRules next = std::move(allStyleRules);
+
+                    // Commit the variable changes and the matched rules together
+                    reactnativecss::Effect::batch([&]() {
+                        for (const auto &kv: variables) {
+                            auto committedIt = committed->find(kv.first);
+                            if (committedIt == committed->end() || committedIt->second != kv.second) {
                                 VariableContext::setVariable(variableScope, kv.first, kv.second);
                             }
                         }
 
-                    }
+                        // Variables no longer defined by any matched rule are unset
+                        for (const auto &kv: *committed) {
+                            if (variables.count(kv.first) == 0) {
+                                VariableContext::setVariable(variableScope, kv.first, AnyValue());
+                            }
+                        }
+
+                        if (!sameRules(matchedRules->get(), next)) {
+                            matchedRules->set(next);
+                        }
+                    });
+
+                    *committed = std::move(variables);
+                });
+    }
+
+    std::shared_ptr<reactnativecss::Computed<Styled *>> makeStyledComputed(
+            const std::shared_ptr<reactnativecss::Observable<MatchedRules>> &matchedRules,
+            const std::string &componentId,
+            const std::function<void()> &rerender,
+            RerenderQueue &rerenders,
+            ShadowTreeUpdateManager &shadowUpdates,
+            AnimationDriver &animations,
+            const std::string &variableScope) {
+
+        // Capture rerender by value (copy) so it persists through fast refresh
+        // Capture the queues and animations by pointer since they are stable singletons
+        auto rerendersPtr = &rerenders;
+        auto shadowUpdatesPtr = &shadowUpdates;
+        auto animationsPtr = &animations;
+
+        auto computed = reactnativecss::Computed<Styled *>::create(
+                [matchedRules, componentId, rerender, rerendersPtr, shadowUpdatesPtr, animationsPtr,
+                        variableScope](
+                        Styled *const &prev,
+                        typename reactnativecss::Effect::GetProxy &get) {
+                    Styled *next = new Styled{};
+                    MergedDeclarations mergedStyles;
+                    MergedDeclarations mergedProps;
+                    MergedDeclarations mergedImportantStyles;
+                    MergedDeclarations mergedImportantProps;
+
+                    static const std::vector<HybridStyleRule> noRules;
+                    const MatchedRules &matched = get(*matchedRules);
+                    const std::vector<HybridStyleRule> &allStyleRules = matched ? *matched : noRules;
 
                     // Process the declarations and props
                     for (const HybridStyleRule &styleRule: allStyleRules) {
@@ -116,6 +198,13 @@ namespace margelo::nitro::cssnitro {
                         }
                     }
 
+                    // Animations and transitions are driven natively, their animation-* and
+                    // transition-* values are handed to the driver instead of reaching the style
+                    std::vector<TransitionSpec> transitionSpecs;
+                    auto animationSpecs = StyledComputedFactory::extractAnimations(
+                            mergedStyles, mergedImportantStyles, variableScope, get,
+                            transitionSpecs);
+
                     // Convert and assign all maps using the helper function
                     if (!mergedStyles.empty()) {
                         next->style = StyledComputedFactory::convertToAnyMap(mergedStyles, true,
@@ -137,35 +226,32 @@ namespace margelo::nitro::cssnitro {
                                 mergedImportantProps, false, variableScope, get);
                     }
 
+                    // Start, update or stop the animations and transitions, the style carries
+                    // their current frame
+                    if (!animationSpecs.empty() || !transitionSpecs.empty() ||
+                        animationsPtr->isAnimating(componentId)) {
+                        StyledComputedFactory::applyAnimations(*animationsPtr, componentId,
+                                                               std::move(animationSpecs),
+                                                               std::move(transitionSpecs), *next);
+                    }
+
                     // Only perform these actions if this is a recompute (prev exists)
                     if (prev != nullptr) {
-                        // Check if animations or transitions are present
-                        bool hasAnimations = false;
-                        if (next->style.has_value()) {
-                            hasAnimations = next->style.value()->contains("animationName") ||
-                                            next->style.value()->contains("transitionProperty");
-                        }
-                        if (!hasAnimations && next->importantStyle.has_value()) {
-                            hasAnimations =
-                                    next->importantStyle.value()->contains("animationName") ||
-                                    next->importantStyle.value()->contains("transitionProperty");
-                        }
-
-                        // If animations/transitions are present, or props changed, we must rerender
-                        if (hasAnimations || next->props.has_value() ||
-                            next->importantProps.has_value()) {
-                            (void) rerender();
+                        auto style = next->style.value_or(nullptr);
+                        auto importantStyle = next->importantStyle.value_or(nullptr);
+                        // Props can't be updated through the shadow tree, they need a rerender,
+                        // but only when one changed: an unchanged placeholderTextColor shouldn't
+                        // turn a hover into a React render. Animation and transition keys never
+                        // reach the props, they are driven natively and frames are style.
+                        if (!sameEntries(prev->props, next->props) ||
+                            !sameEntries(prev->importantProps, next->importantProps)) {
+                            // The rerender applies the whole style
+                            shadowUpdatesPtr->markRendered(componentId, style, importantStyle);
+                            // Queued, a cascade rerenders the component once per batch
+                            rerendersPtr->request(componentId, rerender);
                         } else {
-                            // Only update shadow tree if no animations (shadow tree can't handle them)
-                            reactnativecss::Effect::batch([&]() {
-                                if (next->style.has_value()) {
-                                    shadowUpdatesPtr->addUpdates(componentId, next->style.value());
-                                }
-                                if (next->importantStyle.has_value()) {
-                                    shadowUpdatesPtr->addUpdates(componentId,
-                                                                 next->importantStyle.value());
-                                }
-                            });
+                            // Only the keys that changed since the last update are sent
+                            shadowUpdatesPtr->updateStyle(componentId, style, importantStyle);
                         }
 
                         // Now safe to delete prev
@@ -179,9 +265,77 @@ namespace margelo::nitro::cssnitro {
         return computed;
     }
 
+    std::vector<AnimationSpec> StyledComputedFactory::extractAnimations(
+            MergedDeclarations &mergedStyles,
+            MergedDeclarations &mergedImportantStyles,
+            const std::string &variableScope,
+            reactnativecss::Effect::GetProxy &get,
+            std::vector<TransitionSpec> &transitions) {
+        std::unordered_map<std::string, AnyValue> animationStyle;
+
+        // Important values are moved last so they win
+        for (auto *source: {&mergedStyles, &mergedImportantStyles}) {
+            for (auto it = source->begin(); it != source->end();) {
+                if (AnimationDriver::isAnimationProperty(it->first) ||
+                    AnimationDriver::isTransitionProperty(it->first)) {
+                    animationStyle[it->first] = *it->second;
+                    it = source->erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        if (animationStyle.empty()) {
+            return {};
+        }
+
+        transitions = AnimationDriver::parseTransitions(animationStyle);
+
+        return AnimationDriver::parseAnimations(animationStyle, [&](const std::string &name) {
+            return reactnativecss::animations::getKeyframes(name, variableScope, get)->getMap();
+        });
+    }
+
+    void StyledComputedFactory::applyAnimations(AnimationDriver &animations,
+                                                const std::string &componentId,
+                                                std::vector<AnimationSpec> specs,
+                                                std::vector<TransitionSpec> transitions,
+                                                Styled &styled) {
+        // Important declarations override animations, drop the keyframe values they set
+        if (styled.importantStyle.has_value()) {
+            const auto &important = styled.importantStyle.value()->getMap();
+            for (auto &spec: specs) {
+                for (auto &keyframe: spec.keyframes) {
+                    for (const auto &entry: important) {
+                        keyframe.values.erase(entry.first);
+                    }
+                }
+            }
+        }
+
+        AnyObject base;
+        if (styled.style.has_value()) {
+            base = styled.style.value()->getMap();
+        }
+
+        AnyObject frame = animations.animate(componentId, std::move(specs),
+                                             std::move(transitions), base);
+        if (frame.empty()) {
+            return;
+        }
+
+        if (!styled.style.has_value()) {
+            styled.style = AnyMap::make(frame.size());
+        }
+        for (const auto &entry: frame) {
+            styled.style.value()->setAny(entry.first, entry.second);
+        }
+    }
+
     void StyledComputedFactory::processDeclarations(
             const std::shared_ptr<AnyMap> &declarations,
-            std::unordered_map<std::string, AnyValue> &targetMap,
+            MergedDeclarations &targetMap,
             reactnativecss::Effect::GetProxy &get,
             const std::string &variableScope) {
 
@@ -197,21 +351,26 @@ namespace margelo::nitro::cssnitro {
             // Only set if key doesn't already exist
             if (targetMap.count(kv.first) == 0) {
                 // Use StyleResolver to resolve the value (handles functions, variables, etc.)
-                auto resolvedValue = StyleResolver::resolveStyle(kv.second, variableScope, get);
+                AnyValuePtr holder;
+                const auto &resolvedValue = StyleResolver::resolveStyle(kv.second, variableScope,
+                                                                         get, holder);
 
                 // Skip if resolveStyle returns monostate (unresolved)
                 if (std::holds_alternative<std::monostate>(resolvedValue)) {
                     continue;
                 }
 
-                targetMap[kv.first] = resolvedValue;
+                // Literal values point into the rule's declarations, resolved ones are the
+                // node they were resolved to, neither is copied
+                targetMap.emplace(kv.first, holder ? std::move(holder)
+                                                   : AnyValuePtr(declarations, &kv.second));
             }
         }
     }
 
 
     std::shared_ptr<AnyMap> StyledComputedFactory::convertToAnyMap(
-            const std::unordered_map<std::string, AnyValue> &mergedMap,
+            const MergedDeclarations &mergedMap,
             bool applyStyleMapping,
             const std::string &variableScope,
             reactnativecss::Effect::GetProxy &get) {
@@ -222,7 +381,7 @@ namespace margelo::nitro::cssnitro {
             // For props, just copy all values directly without transform mapping
             auto anyMap = AnyMap::make(mergedMap.size());
             for (const auto &kv: mergedMap) {
-                anyMap->setAny(kv.first, kv.second);
+                anyMap->setAny(kv.first, *kv.second);
             }
             return anyMap;
         }
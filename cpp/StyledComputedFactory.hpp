@@ -3,19 +3,30 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "Styled.hpp"
 #include "HybridStyleRule.hpp"
 #include "ShadowTreeUpdateManager.hpp"
 #include "Observable.hpp"
 #include "Computed.hpp"
+#include "AnimationDriver.hpp"
+#include "RerenderQueue.hpp"
+#include "StyleFunction.hpp"
 
 namespace margelo::nitro::cssnitro {
 
+    // The style rules that currently apply to a component, highest specificity first
+    using MatchedRules = std::shared_ptr<const std::vector<HybridStyleRule>>;
+
+    // Declarations merged across the matched rules. Values are shared with the rule or the
+    // variable they were resolved from, they are only copied into the resulting AnyMap.
+    using MergedDeclarations = std::unordered_map<std::string, AnyValuePtr>;
+
     class StyledComputedFactory {
     public:
         /**
-         * Convert an unordered_map to AnyMap with optional transform property handling.
+         * Convert merged declarations to an AnyMap with optional transform property handling.
          * @param mergedMap The source map to convert
          * @param applyTransformMapping If true, applies special handling for transform properties and animations
          * @param variableScope The scope for variable resolution and animation keyframes
@@ -23,7 +34,7 @@ namespace margelo::nitro::cssnitro {
          * @return The converted AnyMap
          */
         static std::shared_ptr<margelo::nitro::AnyMap> convertToAnyMap(
-                const std::unordered_map<std::string, margelo::nitro::AnyValue> &mergedMap,
+                const MergedDeclarations &mergedMap,
                 bool applyTransformMapping,
                 const std::string &variableScope,
                 reactnativecss::Effect::GetProxy &get);
@@ -37,21 +48,69 @@ namespace margelo::nitro::cssnitro {
          */
         static void processDeclarations(
                 const std::shared_ptr<margelo::nitro::AnyMap> &declarations,
-                std::unordered_map<std::string, margelo::nitro::AnyValue> &targetMap,
+                MergedDeclarations &targetMap,
                 reactnativecss::Effect::GetProxy &get,
                 const std::string &variableScope);
+
+        /**
+         * Move the animation-* and transition-* values out of the merged styles and build
+         * their specs.
+         * @param mergedStyles The merged styles, animation values are removed
+         * @param mergedImportantStyles The merged important styles, animation values are removed
+         * @param variableScope The scope the keyframes are resolved in
+         * @param get The Effect GetProxy for reactive dependencies
+         * @param transitions Receives one spec per transitioned property
+         * @return One spec per animation name, empty if the styles have no animation
+         */
+        static std::vector<AnimationSpec> extractAnimations(
+                MergedDeclarations &mergedStyles,
+                MergedDeclarations &mergedImportantStyles,
+                const std::string &variableScope,
+                reactnativecss::Effect::GetProxy &get,
+                std::vector<TransitionSpec> &transitions);
+
+        /**
+         * Hand a component's animations and transitions to the driver and merge the current
+         * frame into its style.
+         * @param animations The native animation driver
+         * @param componentId The animated component
+         * @param specs The animations from extractAnimations
+         * @param transitions The transitions from extractAnimations
+         * @param styled The resolved result, its style receives the frame
+         */
+        static void applyAnimations(AnimationDriver &animations,
+                                    const std::string &componentId,
+                                    std::vector<AnimationSpec> specs,
+                                    std::vector<TransitionSpec> transitions,
+                                    Styled &styled);
     };
 
-// Build a Computed<Styled*> that resolves styles from classNames against the styleRuleMap
-// and notifies ShadowTreeUpdateManager with the value of next.style for the given componentId.
-    std::shared_ptr<reactnativecss::Computed<Styled *>> makeStyledComputed(
+// Build an Effect that matches classNames against the styleRuleMap and applies the inline
+// variables of the matched rules to variableScope. Only changed variables are written, and
+// they are committed in the same batch as matchedRules, so readers of both update once.
+    std::shared_ptr<reactnativecss::Effect> makeMatchedRulesEffect(
             const std::unordered_map<std::string, std::shared_ptr<reactnativecss::Observable<std::vector<HybridStyleRule>>>> &styleRuleMap,
             const std::string &classNames,
             const std::string &componentId,
-            const std::function<void()> &rerender,
-            ShadowTreeUpdateManager &shadowUpdates,
             const std::string &variableScope,
             const std::string &containerScope,
-            const std::vector<std::string> &validAttributeQueries);
+            const std::vector<std::string> &validAttributeQueries,
+            const std::shared_ptr<reactnativecss::Observable<MatchedRules>> &matchedRules);
+
+// Build a Computed<Styled*> that resolves the declarations of the matched rules
+// and notifies ShadowTreeUpdateManager with the value of next.style for the given componentId.
+// Keyframe animations and transitions are handed to the AnimationDriver, which streams their
+// frames natively. Prop changes queue rerender in the RerenderQueue.
+// Resolving the style only reads observables. A recompute then writes two of them: staging
+// the update bumps the runtime's staged counter and a rerender request bumps the queue's.
+// The effects they wake run when the current batch ends, or immediately outside of one.
+    std::shared_ptr<reactnativecss::Computed<Styled *>> makeStyledComputed(
+            const std::shared_ptr<reactnativecss::Observable<MatchedRules>> &matchedRules,
+            const std::string &componentId,
+            const std::function<void()> &rerender,
+            RerenderQueue &rerenders,
+            ShadowTreeUpdateManager &shadowUpdates,
+            AnimationDriver &animations,
+            const std::string &variableScope);
 
 } // namespace margelo::nitro::cssnitro
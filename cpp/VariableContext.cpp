@@ -8,57 +8,158 @@ namespace margelo::nitro::cssnitro {
     using AnyMap = ::margelo::nitro::AnyMap;
     using AnyObject = ::margelo::nitro::AnyObject;
 
-    // Initialize the static contexts map
-    std::unordered_map<std::string, VariableContext::Context> VariableContext::contexts;
-    std::unordered_map<std::string, std::shared_ptr<reactnativecss::Observable<AnyValue>>> VariableContext::root_values;
-    std::unordered_map<std::string, std::shared_ptr<reactnativecss::Observable<AnyValue>>> VariableContext::universal_values;
+    // Initialize the static contexts map. "root" and "universal" always exist.
+    std::unordered_map<std::string, VariableContext::Context> VariableContext::contexts = {
+            {"root",      VariableContext::Context{"root", {}}},
+            {"universal", VariableContext::Context{"root", {}}},
+    };
+    std::unordered_map<std::string, std::unordered_set<std::string>> VariableContext::children;
+    std::unordered_map<std::string, std::unordered_map<std::string, std::shared_ptr<reactnativecss::Computed<AnyValuePtr>>>> VariableContext::resolved;
+    std::unordered_map<std::string, std::shared_ptr<reactnativecss::Observable<VariableContext::TopLevelValuePtr>>> VariableContext::root_values;
+    std::unordered_map<std::string, std::shared_ptr<reactnativecss::Observable<VariableContext::TopLevelValuePtr>>> VariableContext::universal_values;
 
     void VariableContext::createContext(const std::string &key, const std::string &parent) {
-        // Check if context already exists
-        if (contexts.find(key) != contexts.end()) {
-            // Context already exists, don't overwrite it
-            return;
+        auto contextIt = contexts.find(key);
+        if (contextIt != contexts.end()) {
+            // Context already exists, don't overwrite it. Only a new parent changes the chain.
+            if (contextIt->second.parent == parent) {
+                return;
+            }
+            children[contextIt->second.parent].erase(key);
+            contextIt->second.parent = parent;
+        } else {
+            // Create a new context with the specified parent
+            Context ctx;
+            ctx.parent = parent;
+            ctx.values = std::unordered_map<std::string, VariableValue>();
+            contexts[key] = ctx;
         }
 
-        // Create a new context with the specified parent
-        Context ctx;
-        ctx.parent = parent;
-        ctx.values = std::unordered_map<std::string, VariableValue>();
-        contexts[key] = ctx;
+        if (parent != key) {
+            children[parent].insert(key);
+        }
+
+        // Lookups from this context (or below it) may now resolve differently
+        invalidateScope(key);
     }
 
     void VariableContext::deleteContext(const std::string &key) {
-        // Remove the context from the map
-        contexts.erase(key);
+        // Lookups may have been made from a key that never had a context of its own, so the
+        // lookup nodes and the children entry are released whether or not the context exists
+        auto contextIt = contexts.find(key);
+        if (contextIt != contexts.end()) {
+            auto parentIt = children.find(contextIt->second.parent);
+            if (parentIt != children.end()) {
+                parentIt->second.erase(key);
+                if (parentIt->second.empty()) {
+                    children.erase(parentIt);
+                }
+            }
+            contexts.erase(contextIt);
+        }
+
+        // Dispose the lookup nodes that started from this context
+        auto resolvedIt = resolved.find(key);
+        if (resolvedIt != resolved.end()) {
+            for (auto &entry: resolvedIt->second) {
+                entry.second->dispose();
+            }
+            resolved.erase(resolvedIt);
+        }
+
+        // Children have lost part of their chain
+        auto childrenIt = children.find(key);
+        if (childrenIt != children.end()) {
+            auto orphans = std::move(childrenIt->second);
+            children.erase(childrenIt);
+            for (const auto &child: orphans) {
+                invalidateScope(child);
+            }
+        }
     }
 
-    AnyValue VariableContext::getValue(const VariableValue &varValue,
-                                       reactnativecss::Effect::GetProxy &get) {
+    size_t VariableContext::size() {
+        return contexts.size();
+    }
+
+    void VariableContext::invalidateScope(const std::string &key) {
+        // Batch so recomputes run after the walk, they may create new lookup nodes
+        reactnativecss::Effect::batch([&]() {
+            std::vector<std::string> stack{key};
+            std::unordered_set<std::string> visited;
+
+            while (!stack.empty()) {
+                std::string current = std::move(stack.back());
+                stack.pop_back();
+                if (!visited.insert(current).second) {
+                    continue;
+                }
+
+                auto resolvedIt = resolved.find(current);
+                if (resolvedIt != resolved.end()) {
+                    for (auto &entry: resolvedIt->second) {
+                        entry.second->invalidate();
+                    }
+                }
+
+                auto childrenIt = children.find(current);
+                if (childrenIt != children.end()) {
+                    stack.insert(stack.end(), childrenIt->second.begin(),
+                                 childrenIt->second.end());
+                }
+            }
+        });
+    }
+
+    void VariableContext::invalidateName(const std::string &name) {
+        reactnativecss::Effect::batch([&]() {
+            for (auto &scope: resolved) {
+                auto nodeIt = scope.second.find(name);
+                if (nodeIt != scope.second.end()) {
+                    nodeIt->second->invalidate();
+                }
+            }
+        });
+    }
+
+    const AnyValue &VariableContext::getValue(const VariableValue &varValue,
+                                              reactnativecss::Effect::GetProxy &get) {
         if (std::holds_alternative<std::shared_ptr<reactnativecss::Observable<AnyValue>>>(
                 varValue)) {
-            auto obs = std::get<std::shared_ptr<reactnativecss::Observable<AnyValue>>>(varValue);
+            const auto &obs = std::get<std::shared_ptr<reactnativecss::Observable<AnyValue>>>(
+                    varValue);
             return get(*obs);
         } else {
-            auto comp = std::get<std::shared_ptr<reactnativecss::Computed<AnyValue>>>(varValue);
+            const auto &comp = std::get<std::shared_ptr<reactnativecss::Computed<AnyValue>>>(
+                    varValue);
             return get(*comp);
         }
     }
 
-    std::optional<AnyValue> VariableContext::checkContext(const std::string &contextKey,
-                                                          const std::string &name,
-                                                          reactnativecss::Effect::GetProxy &get) {
-        // If this is a root or universal context, ensure it exists
-        if (contextKey == "root" || contextKey == "universal") {
-            createContext(contextKey, "root");
+    // Resolve a stored value into a shared node. Values that are themselves var() references
+    // reuse the referenced node, so only literal values are copied (once per recompute).
+    static AnyValuePtr shareResolved(const AnyValue &value, const std::string &contextKey,
+                                     reactnativecss::Effect::GetProxy &get) {
+        AnyValuePtr holder;
+        const AnyValue &resolvedValue = StyleResolver::resolveStyle(value, contextKey, get,
+                                                                    holder);
+        if (holder || std::holds_alternative<std::monostate>(resolvedValue)) {
+            return holder;
         }
+        return std::make_shared<const AnyValue>(resolvedValue);
+    }
 
+    AnyValuePtr VariableContext::checkContext(const std::string &contextKey,
+                                              const std::string &name,
+                                              reactnativecss::Effect::GetProxy &get) {
         auto contextIt = contexts.find(contextKey);
         if (contextIt != contexts.end()) {
             auto &valueMap = contextIt->second.values;
             auto varIt = valueMap.find(name);
             if (varIt != valueMap.end()) {
-                AnyValue value = getValue(varIt->second, get);
-                return StyleResolver::resolveStyle(value, contextKey, get);
+                // Hold the storage alive while resolving, resolution may touch valueMap
+                VariableValue storage = varIt->second;
+                return shareResolved(getValue(storage, get), contextKey, get);
             } else {
                 // Variable doesn't exist in this context
                 // Check if this is a root or universal context
@@ -69,8 +170,7 @@ namespace margelo::nitro::cssnitro {
                     valueMap[name] = computed;
 
                     // Get the initial value from the computed
-                    AnyValue value = getValue(computed, get);
-                    return StyleResolver::resolveStyle(value, contextKey, get);
+                    return shareResolved(getValue(computed, get), contextKey, get);
                 } else {
                     // For other contexts, create a new Observable with nullptr
                     auto observable = reactnativecss::Observable<AnyValue>::create(AnyValue());
@@ -81,22 +181,51 @@ namespace margelo::nitro::cssnitro {
                 }
             }
         }
-        return std::nullopt;
+        return nullptr;
     }
 
-    std::optional<AnyValue>
+    AnyValuePtr
     VariableContext::getVariable(const std::string &key, const std::string &name,
                                  reactnativecss::Effect::GetProxy &get) {
+        auto &node = resolved[key][name];
+        if (!node) {
+            node = createResolvedVariable(key, name);
+        }
+
+        // Subscribe to the memoized lookup only, not to every context along the chain.
+        // nullptr means the variable doesn't exist in any context.
+        return get(*node);
+    }
+
+    std::shared_ptr<reactnativecss::Computed<AnyValuePtr>>
+    VariableContext::createResolvedVariable(const std::string &key, const std::string &name) {
+        return reactnativecss::Computed<AnyValuePtr>::create(
+                [key, name](const AnyValuePtr &prev,
+                            reactnativecss::Effect::GetProxy &get) -> AnyValuePtr {
+                    auto next = resolveVariable(key, name, get);
+
+                    // Keep the previous node when the value is unchanged, so subscribers
+                    // (which compare by pointer) are not woken up
+                    if (prev == next || (prev && next && *prev == *next)) {
+                        return prev;
+                    }
+                    return next;
+                },
+                nullptr);
+    }
+
+    AnyValuePtr VariableContext::resolveVariable(const std::string &key, const std::string &name,
+                                              reactnativecss::Effect::GetProxy &get) {
         // 1. Check current key
         auto result = checkContext(key, name, get);
-        if (result.has_value() && !std::holds_alternative<std::monostate>(result.value())) {
+        if (result) {
             return result;
         }
 
         // 2. Check "universal" context (if we're not already in it)
         if (key != "universal") {
             result = checkContext("universal", name, get);
-            if (result.has_value() && !std::holds_alternative<std::monostate>(result.value())) {
+            if (result) {
                 return result;
             }
 
@@ -110,8 +239,7 @@ namespace margelo::nitro::cssnitro {
                     // Walk up parent chain until we hit root (parent points to itself)
                     while (parentKey != currentKey && !parentKey.empty()) {
                         result = checkContext(parentKey, name, get);
-                        if (result.has_value() &&
-                            !std::holds_alternative<std::monostate>(result.value())) {
+                        if (result) {
                             return result;
                         }
 
@@ -128,8 +256,7 @@ namespace margelo::nitro::cssnitro {
             }
         }
 
-        // Variable doesn't exist in any context
-        return std::nullopt;
+        return nullptr;
     }
 
     void VariableContext::setVariable(const std::string &key, const std::string &name,
@@ -165,8 +292,14 @@ namespace margelo::nitro::cssnitro {
         }
 
         // Create a new Observable with the value
+        bool replaced = varIt != valueMap.end();
         auto observable = reactnativecss::Observable<AnyValue>::create(value);
         valueMap[name] = observable;
+
+        // Memoized lookups may be subscribed to the value that was replaced
+        if (replaced) {
+            invalidateName(name);
+        }
     }
 
     void VariableContext::setVariable(const std::string &key, const std::string &name,
@@ -193,7 +326,13 @@ namespace margelo::nitro::cssnitro {
         }
 
         // Set the variable to use the provided Computed directly
+        bool replaced = varIt != valueMap.end();
         valueMap[name] = computed;
+
+        // Memoized lookups may be subscribed to the value that was replaced
+        if (replaced) {
+            invalidateName(name);
+        }
     }
 
     void VariableContext::setTopLevelVariable(const std::string &key, const std::string &name,
@@ -204,11 +343,15 @@ namespace margelo::nitro::cssnitro {
         // Find or create the observable in the target map
         auto observableIt = targetMap.find(name);
         if (observableIt != targetMap.end()) {
-            // Observable already exists, just update its value
-            observableIt->second->set(value);
+            // Skip recompiling an unchanged payload
+            const auto &current = observableIt->second->get();
+            if (!current || current->source != value) {
+                observableIt->second->set(compileTopLevelValue(value));
+            }
         } else {
-            // Create a new Observable with the value
-            auto observable = reactnativecss::Observable<AnyValue>::create(value);
+            // Create a new Observable with the compiled value
+            auto observable = reactnativecss::Observable<TopLevelValuePtr>::create(
+                    compileTopLevelValue(value));
             targetMap[name] = observable;
         }
 
@@ -226,9 +369,51 @@ namespace margelo::nitro::cssnitro {
         }
     }
 
+    VariableContext::TopLevelValuePtr VariableContext::compileTopLevelValue(const AnyValue &value) {
+        auto compiled = std::make_shared<TopLevelValue>();
+        compiled->source = value;
+
+        // Anything other than an array has no candidates
+        if (!std::holds_alternative<AnyArray>(value)) {
+            return compiled;
+        }
+
+        for (const auto &item: std::get<AnyArray>(value)) {
+            // Each item should be an object with "v" and "m" keys
+            if (!std::holds_alternative<AnyObject>(item)) {
+                continue;
+            }
+
+            const auto &obj = std::get<AnyObject>(item);
+
+            // Items without a "v" can never be selected
+            auto vIt = obj.find("v");
+            if (vIt == obj.end()) {
+                continue;
+            }
+
+            TopLevelCandidate candidate;
+            candidate.value = vIt->second;
+
+            // Check if "m" is set
+            auto mIt = obj.find("m");
+            if (mIt != obj.end() && !std::holds_alternative<std::monostate>(mIt->second)) {
+                // "m" exists but is not an AnyObject, skip this item
+                if (!std::holds_alternative<AnyObject>(mIt->second)) {
+                    continue;
+                }
+                candidate.media = Rules::compileMedia(std::get<AnyObject>(mIt->second));
+            }
+
+            compiled->candidates.push_back(std::move(candidate));
+        }
+
+        return compiled;
+    }
+
     std::shared_ptr<reactnativecss::Computed<AnyValue>>
     VariableContext::createTopLevelVariableComputed(
-            std::unordered_map<std::string, std::shared_ptr<reactnativecss::Observable<AnyValue>>> &targetMap,
+            std::unordered_map<std::string, std::shared_ptr<reactnativecss::Observable<TopLevelValuePtr>>> &targetMap,
             const std::string &name) {
         return reactnativecss::Computed<AnyValue>::create(
                 [&targetMap, name](const AnyValue &prev,
@@ -238,63 +423,25 @@ namespace margelo::nitro::cssnitro {
                     // Read from the target map
                     auto it = targetMap.find(name);
                     if (it != targetMap.end()) {
-                        auto value = get(*it->second);
-
-                        // Check if value is an array
-                        if (!std::holds_alternative<AnyArray>(value)) {
+                        const auto &compiled = get(*it->second);
+                        if (!compiled) {
                             return AnyValue();
                         }
 
-                        const auto &arr = std::get<AnyArray>(value);
-
-                        // Loop over the array
-                        for (const auto &item: arr) {
-                            // Each item should be an object with "v" and "m" keys
-                            if (!std::holds_alternative<AnyObject>(item)) {
+                        // Return the first candidate whose media matches (or has none)
+                        for (const auto &candidate: compiled->candidates) {
+                            if (candidate.media.has_value() &&
+                                !Rules::testCompiledMedia(candidate.media.value(), get)) {
                                 continue;
                             }
-
-                            const auto &obj = std::get<AnyObject>(item);
-
-                            // Check if "m" is set
-                            auto mIt = obj.find("m");
-                            if (mIt != obj.end() &&
-                                !std::holds_alternative<std::monostate>(mIt->second)) {
-                                // "m" is set, test the media query/condition
-                                const auto &mValue = mIt->second;
-
-                                // Convert AnyValue to AnyMap if it's an object
-                                if (std::holds_alternative<AnyObject>(mValue)) {
-                                    const auto &mediaObj = std::get<AnyObject>(mValue);
-                                    auto mediaMap = AnyMap::make(mediaObj.size());
-
-                                    // Copy the object into an AnyMap
-                                    for (const auto &kv: mediaObj) {
-                                        mediaMap->setAny(kv.first, kv.second);
-                                    }
-
-                                    // Test the rule - if it doesn't pass, continue to next item
-                                    if (!Rules::testVariableMedia(mediaMap, get)) {
-                                        continue;
-                                    }
-                                    // If it passes, fall through to return the "v" value
-                                } else {
-                                    // "m" exists but is not an AnyObject, skip this item
-                                    continue;
-                                }
-                            }
-
-                            // "m" is not set or the media query passed, return the value of "v"
-                            auto vIt = obj.find("v");
-                            if (vIt != obj.end()) {
-                                return vIt->second;
-                            }
+                            return candidate.value;
                         }
 
                         return AnyValue();
                     } else {
                         // Observable doesn't exist, create it and subscribe
-                        auto observable = reactnativecss::Observable<AnyValue>::create(AnyValue());
+                        auto observable = reactnativecss::Observable<TopLevelValuePtr>::create(
+                                nullptr);
                         targetMap[name] = observable;
 
                         // Subscribe to the observable
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
 #include <optional>
 #include <variant>
@@ -9,6 +10,8 @@
 #include "Observable.hpp"
 #include "Computed.hpp"
 #include "Effect.hpp"
+#include "Rules.hpp"
+#include "StyleFunction.hpp"
 
 namespace margelo::nitro::cssnitro {
 
@@ -27,22 +30,48 @@ namespace margelo::nitro::cssnitro {
             std::unordered_map<std::string, VariableValue> values;
         };
 
+        // A top-level candidate: the value applies when its media matches (or has none)
+        struct TopLevelCandidate {
+            std::optional<CompiledMedia> media;
+            AnyValue value;
+        };
+
+        // A root/universal variable payload ([{ v, m }, ...]) compiled once when it is set
+        struct TopLevelValue {
+            AnyValue source;
+            std::vector<TopLevelCandidate> candidates;
+        };
+
+        using TopLevelValuePtr = std::shared_ptr<const TopLevelValue>;
+
         // Static map: context key -> Context
         static std::unordered_map<std::string, Context> contexts;
 
+        // Static map: parent key -> child context keys (the parent may not exist yet)
+        static std::unordered_map<std::string, std::unordered_set<std::string>> children;
+
+        // Memoized lookups: context key -> variable name -> resolved value.
+        // Each node walks the lookup chain once and then only recomputes when a value
+        // along the chain changes, or when the chain itself is invalidated.
+        // Values are immutable and shared, so reading one is a pointer copy.
+        static std::unordered_map<std::string, std::unordered_map<std::string, std::shared_ptr<reactnativecss::Computed<AnyValuePtr>>>> resolved;
+
         // Static maps for root and universal values
-        static std::unordered_map<std::string, std::shared_ptr<reactnativecss::Observable<AnyValue>>> root_values;
-        static std::unordered_map<std::string, std::shared_ptr<reactnativecss::Observable<AnyValue>>> universal_values;
+        static std::unordered_map<std::string, std::shared_ptr<reactnativecss::Observable<TopLevelValuePtr>>> root_values;
+        static std::unordered_map<std::string, std::shared_ptr<reactnativecss::Observable<TopLevelValuePtr>>> universal_values;
 
-        // Create a new context with the given key and parent
+        // Create a new context with the given key and parent, or re-parent an existing one
         static void createContext(const std::string &key, const std::string &parent);
 
         // Delete a context by key
         static void deleteContext(const std::string &key);
 
+        // The number of contexts, including "root" and "universal"
+        static size_t size();
+
         // Get a variable from a context, subscribing the effect to changes
-        // Returns std::nullopt if the context or variable doesn't exist
-        static std::optional<AnyValue> getVariable(const std::string &key, const std::string &name,
+        // Returns nullptr if the context or variable doesn't exist
+        static AnyValuePtr getVariable(const std::string &key, const std::string &name,
                                                    reactnativecss::Effect::GetProxy &get);
 
         // Set a variable in a context (creates an Observable)
@@ -60,19 +89,37 @@ namespace margelo::nitro::cssnitro {
     private:
         VariableContext() = delete; // Static-only class
 
+        // Create the memoized lookup node for a (context, name) pair
+        static std::shared_ptr<reactnativecss::Computed<AnyValuePtr>>
+        createResolvedVariable(const std::string &key, const std::string &name);
+
+        // Walk the lookup chain: the context, then "universal", then the parent chain
+        static AnyValuePtr
+        resolveVariable(const std::string &key, const std::string &name,
+                        reactnativecss::Effect::GetProxy &get);
+
+        // Recompute the lookup nodes of a context and all of its descendants
+        static void invalidateScope(const std::string &key);
+
+        // Recompute every lookup node for a variable name
+        static void invalidateName(const std::string &name);
+
         // Helper to get value from a VariableValue variant
-        static AnyValue
+        static const AnyValue &
         getValue(const VariableValue &varValue, reactnativecss::Effect::GetProxy &get);
 
         // Helper to check a specific context for the variable
-        static std::optional<AnyValue>
+        static AnyValuePtr
         checkContext(const std::string &contextKey, const std::string &name,
                      reactnativecss::Effect::GetProxy &get);
 
+        // Compile a top-level payload into its ordered candidates
+        static TopLevelValuePtr compileTopLevelValue(const AnyValue &value);
+
         // Factory function to create a Computed for top-level variables
         static std::shared_ptr<reactnativecss::Computed<AnyValue>>
         createTopLevelVariableComputed(
-                std::unordered_map<std::string, std::shared_ptr<reactnativecss::Observable<AnyValue>>> &targetMap,
+                std::unordered_map<std::string, std::shared_ptr<reactnativecss::Observable<TopLevelValuePtr>>> &targetMap,
                 const std::string &name);
     };
 
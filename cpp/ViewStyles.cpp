@@ -0,0 +1,69 @@
+#include "ViewStyles.hpp"
+
+#include "StyleDiff.hpp"
+
+namespace margelo::nitro::cssnitro {
+
+    void ViewStyles::rendered(const std::string &componentId, AnyObject style) {
+        View &view = views_[componentId];
+        if (view.linked) {
+            view.sent = style;
+        } else {
+            pending_.erase(componentId);
+        }
+        view.rendered = std::move(style);
+    }
+
+    AnyObject ViewStyles::link(const std::string &componentId, bool newView) {
+        View &view = views_[componentId];
+        if (newView || !view.linked) {
+            view.sent = view.rendered;
+        }
+        view.linked = true;
+
+        auto parked = pending_.take(componentId);
+        if (!parked) {
+            return {};
+        }
+        return parked->full ? StyleDiff::full(view.sent, std::move(parked->style))
+                            : StyleDiff::partial(view.sent, parked->style);
+    }
+
+    void ViewStyles::unlink(const std::string &componentId) {
+        pending_.erase(componentId);
+        auto it = views_.find(componentId);
+        if (it != views_.end()) {
+            it->second.linked = false;
+            it->second.sent.clear();
+        }
+    }
+
+    void ViewStyles::remove(const std::string &componentId) {
+        pending_.erase(componentId);
+        views_.erase(componentId);
+    }
+
+    bool ViewStyles::isLinked(const std::string &componentId) const {
+        auto it = views_.find(componentId);
+        return it != views_.end() && it->second.linked;
+    }
+
+    AnyObject ViewStyles::full(const std::string &componentId, AnyObject style) {
+        auto it = views_.find(componentId);
+        if (it == views_.end() || !it->second.linked) {
+            pending_.replace(componentId, std::move(style));
+            return {};
+        }
+        return StyleDiff::full(it->second.sent, std::move(style));
+    }
+
+    AnyObject ViewStyles::partial(const std::string &componentId, const AnyObject &entries) {
+        auto it = views_.find(componentId);
+        if (it == views_.end() || !it->second.linked) {
+            pending_.merge(componentId, entries);
+            return {};
+        }
+        return StyleDiff::partial(it->second.sent, entries);
+    }
+
+} // namespace margelo::nitro::cssnitro
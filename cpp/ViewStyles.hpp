@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+
+#include <NitroModules/AnyMap.hpp>
+
+#include "PendingStyles.hpp"
+
+namespace margelo::nitro::cssnitro {
+
+    using ::margelo::nitro::AnyObject;
+
+    /**
+     * The style each component's view holds, so updates only carry what differs from it.
+     * A view starts out with the style React rendered it with, later updates are diffed
+     * against that and keys that are no longer set are reset with null. Updates of
+     * components without a view are parked and replayed when the view is linked.
+     */
+    class ViewStyles {
+    public:
+        explicit ViewStyles(size_t pendingCapacity) : pending_(pendingCapacity) {}
+
+        // Record the style a render gave the component, it supersedes anything parked
+        void rendered(const std::string &componentId, AnyObject style);
+
+        /**
+         * Link the component to a view and return the parked changes to send it. A new or
+         * relinked view starts out with the rendered style, linking the linked view again
+         * keeps what it was already sent.
+         */
+        AnyObject link(const std::string &componentId, bool newView);
+
+        // The view is gone, the rendered style is kept for the next one
+        void unlink(const std::string &componentId);
+
+        // Forget the component entirely, e.g. when it is deregistered
+        void remove(const std::string &componentId);
+
+        bool isLinked(const std::string &componentId) const;
+
+        // Returns the changes to send for the full resolved style, or parks it without a view
+        AnyObject full(const std::string &componentId, AnyObject style);
+
+        // Returns the changes to send for a partial update, or parks it without a view
+        AnyObject partial(const std::string &componentId, const AnyObject &entries);
+
+        size_t size() const {
+            return views_.size();
+        }
+
+    private:
+        struct View {
+            AnyObject rendered;
+            AnyObject sent;
+            bool linked = false;
+        };
+
+        std::unordered_map<std::string, View> views_;
+        PendingStyles pending_;
+    };
+
+} // namespace margelo::nitro::cssnitro
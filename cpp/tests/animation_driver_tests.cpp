@@ -0,0 +1,348 @@
+// doctest-based tests for the native animation and transition driver
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../AnimationDriver.hpp"
+#include "../Color.hpp"
+#include "../FrameTicker.hpp"
+#include "../ShadowTreeStaging.hpp"
+#include "../StyleKeys.hpp"
+#include "../ViewStyles.hpp"
+
+using margelo::nitro::AnyArray;
+using margelo::nitro::AnyObject;
+using margelo::nitro::AnyValue;
+using margelo::nitro::cssnitro::AnimationDirection;
+using margelo::nitro::cssnitro::AnimationDriver;
+using margelo::nitro::cssnitro::AnimationFillMode;
+using margelo::nitro::cssnitro::AnimationSpec;
+using margelo::nitro::cssnitro::Color;
+using margelo::nitro::cssnitro::FrameTicker;
+using margelo::nitro::cssnitro::ShadowTreeStaging;
+using margelo::nitro::cssnitro::StyleKeyKind;
+using margelo::nitro::cssnitro::StyleKeys;
+using margelo::nitro::cssnitro::TransitionSpec;
+using margelo::nitro::cssnitro::ViewStyles;
+
+namespace {
+
+// A fade from opacity 0 to 1 over 100ms
+AnimationSpec fade() {
+  AnyObject from;
+  from["opacity"] = 0.0;
+  AnyObject to;
+  to["opacity"] = 1.0;
+  AnyObject keyframes;
+  keyframes["from"] = from;
+  keyframes["to"] = to;
+
+  AnimationSpec spec;
+  spec.name = "fade";
+  spec.keyframes = AnimationDriver::parseKeyframes(keyframes);
+  spec.duration = 100;
+  spec.timingFunction = std::string("linear");
+  return spec;
+}
+
+double opacity(const AnyObject &frame) {
+  return std::get<double>(frame.at("opacity"));
+}
+
+struct StyleTraits {
+  static void merge(AnyObject &into, AnyObject &&from) {
+    for (auto &entry : from) {
+      into[entry.first] = std::move(entry.second);
+    }
+  }
+
+  static size_t count(const AnyObject &payload) { return payload.size(); }
+};
+
+using FrameStaging = ShadowTreeStaging<int, AnyObject, StyleTraits>;
+
+// Wait up to a second for the ticker to run out of work
+bool settles(const FrameTicker &ticker) {
+  for (int i = 0; i < 1000 && ticker.ticking(); i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return !ticker.ticking();
+}
+
+} // namespace
+
+TEST_CASE("animation frames follow the clock") {
+  double now = 0;
+  AnimationDriver driver([&now] { return now; });
+
+  AnyObject first = driver.animate("a", {fade()}, {}, AnyObject{});
+  CHECK(opacity(first) == doctest::Approx(0));
+  CHECK(driver.active());
+
+  now = 25;
+  auto frames = driver.tick();
+  REQUIRE(frames.size() == 1);
+  CHECK(frames[0].first == "a");
+  CHECK(opacity(frames[0].second) == doctest::Approx(0.25));
+
+  // Nothing changes without time passing
+  CHECK(driver.tick().empty());
+}
+
+TEST_CASE("finished animations restore the base style unless filled") {
+  double now = 0;
+  AnimationDriver driver([&now] { return now; });
+
+  AnyObject base;
+  base["opacity"] = 0.5;
+  driver.animate("a", {fade()}, {}, base);
+
+  now = 150;
+  auto frames = driver.tick();
+  REQUIRE(frames.size() == 1);
+  CHECK(opacity(frames[0].second) == doctest::Approx(0.5));
+  CHECK_FALSE(driver.active());
+
+  auto filled = fade();
+  filled.fillMode = AnimationFillMode::Forwards;
+  now = 0;
+  driver.animate("b", {filled}, {}, base);
+  now = 150;
+  frames = driver.tick();
+  REQUIRE(frames.size() == 1);
+  CHECK(opacity(frames[0].second) == doctest::Approx(1));
+}
+
+TEST_CASE("restyling keeps a running animation's start time") {
+  double now = 0;
+  AnimationDriver driver([&now] { return now; });
+  driver.animate("a", {fade()}, {}, AnyObject{});
+
+  now = 50;
+  AnyObject frame = driver.animate("a", {fade()}, {}, AnyObject{});
+  CHECK(opacity(frame) == doctest::Approx(0.5));
+
+  // Removing the animation resets the animated property
+  frame = driver.animate("a", {}, {}, AnyObject{});
+  CHECK(std::holds_alternative<std::monostate>(frame.at("opacity")));
+  CHECK_FALSE(driver.isAnimating("a"));
+}
+
+TEST_CASE("alternate iterations run backwards") {
+  double now = 0;
+  AnimationDriver driver([&now] { return now; });
+  auto spec = fade();
+  spec.iterations = 2;
+  spec.direction = AnimationDirection::Alternate;
+  driver.animate("a", {spec}, {}, AnyObject{});
+
+  now = 125;
+  auto frames = driver.tick();
+  REQUIRE(frames.size() == 1);
+  CHECK(opacity(frames[0].second) == doctest::Approx(0.75));
+}
+
+TEST_CASE("an infinite animation without a duration rests at its end") {
+  double now = 0;
+  AnimationDriver driver([&now] { return now; });
+  auto spec = fade();
+  spec.duration = 0;
+  spec.iterations = INFINITY;
+  spec.fillMode = AnimationFillMode::Forwards;
+
+  AnyObject frame = driver.animate("a", {spec}, {}, AnyObject{});
+  CHECK_FALSE(std::isnan(opacity(frame)));
+  CHECK(opacity(frame) == doctest::Approx(1));
+  CHECK_FALSE(driver.active());
+}
+
+TEST_CASE("changed transitioned properties start from the value on screen") {
+  double now = 0;
+  AnimationDriver driver([&now] { return now; });
+
+  TransitionSpec spec;
+  spec.property = "opacity";
+  spec.duration = 100;
+  spec.timingFunction = std::string("linear");
+
+  AnyObject base;
+  base["opacity"] = 0.0;
+  base["width"] = 10.0;
+  CHECK(driver.animate("a", {}, {spec}, base).empty());
+  CHECK_FALSE(driver.active());
+
+  // A change starts the transition from the previous value
+  base["opacity"] = 1.0;
+  base["width"] = 20.0;
+  AnyObject frame = driver.animate("a", {}, {spec}, base);
+  CHECK(opacity(frame) == doctest::Approx(0));
+  CHECK(frame.count("width") == 0);
+
+  now = 50;
+  auto frames = driver.tick();
+  REQUIRE(frames.size() == 1);
+  CHECK(opacity(frames[0].second) == doctest::Approx(0.5));
+
+  // Reversing midway starts from the current value
+  base["opacity"] = 0.0;
+  frame = driver.animate("a", {}, {spec}, base);
+  CHECK(opacity(frame) == doctest::Approx(0.5));
+
+  now = 100;
+  frames = driver.tick();
+  REQUIRE(frames.size() == 1);
+  CHECK(opacity(frames[0].second) == doctest::Approx(0.25));
+
+  // Once ended, the base value applies
+  now = 200;
+  frames = driver.tick();
+  REQUIRE(frames.size() == 1);
+  CHECK(opacity(frames[0].second) == doctest::Approx(0));
+  CHECK_FALSE(driver.active());
+}
+
+TEST_CASE("transition-property names match style keys") {
+  std::unordered_map<std::string, AnyValue> style;
+  style["transitionProperty"] = AnyArray{std::string("background-color"), std::string("margin")};
+  style["transitionDuration"] = AnyArray{200.0};
+  auto specs = AnimationDriver::parseTransitions(style);
+  REQUIRE(specs.size() == 2);
+  CHECK(specs[0].property == "backgroundColor");
+  CHECK(specs[1].property == "margin");
+  CHECK(specs[1].duration == doctest::Approx(200));
+}
+
+TEST_CASE("colors, units and transforms interpolate") {
+  auto color = AnimationDriver::interpolate("backgroundColor", std::string("#000000"),
+                                            std::string("#ff0000"), 0.5);
+  CHECK(std::get<std::string>(color) == "rgba(128, 0, 0, 1)");
+
+  auto angle = AnimationDriver::interpolate("rotate", std::string("0deg"),
+                                            std::string("90deg"), 0.5);
+  CHECK(std::get<std::string>(angle) == "45deg");
+
+  AnyObject fromItem;
+  fromItem["translateX"] = 0.0;
+  AnyObject toItem;
+  toItem["translateX"] = 10.0;
+  auto transform = AnimationDriver::interpolate("transform", AnyArray{fromItem},
+                                                AnyArray{toItem}, 0.3);
+  const auto &item = std::get<AnyObject>(std::get<AnyArray>(transform)[0]);
+  CHECK(std::get<double>(item.at("translateX")) == doctest::Approx(3));
+
+  // Discrete values flip halfway
+  auto display = AnimationDriver::interpolate("display", std::string("flex"),
+                                              std::string("none"), 0.4);
+  CHECK(std::get<std::string>(display) == "flex");
+}
+
+TEST_CASE("colors convert to processColor integers") {
+  auto red = Color::parse("#f00");
+  REQUIRE(red.has_value());
+  CHECK(Color::toProcessed(*red) == static_cast<int32_t>(0xffff0000));
+  CHECK_FALSE(Color::parse("not-a-color").has_value());
+}
+
+TEST_CASE("css color syntaxes parse natively") {
+  auto processed = [](const char *value) {
+    auto color = Color::parse(value);
+    return color ? static_cast<uint32_t>(Color::toProcessed(*color)) : 0u;
+  };
+  CHECK(processed("#11223344") == 0x44112233u);
+  CHECK(processed("rgba(255 0 0 / 50%)") == 0x80ff0000u);
+  CHECK(processed("hsl(120deg 100% 50%)") == 0xff00ff00u);
+  CHECK(processed("hsla(0.5turn, 100%, 25%, 1)") == 0xff008080u);
+  CHECK(processed("hwb(0 50% 50%)") == 0xff808080u);
+  CHECK(processed("rebeccapurple") == 0xff663399u);
+  CHECK(processed("transparent") == 0u);
+  CHECK_FALSE(Color::parse("PlatformColor(labelColor)").has_value());
+}
+
+TEST_CASE("style keys are classified without scanning known keys") {
+  CHECK(StyleKeys::classify("backgroundColor") == StyleKeyKind::Color);
+  CHECK(StyleKeys::classify("transform") == StyleKeyKind::Transform);
+  CHECK(StyleKeys::classify("marginTop") == StyleKeyKind::Dimension);
+  CHECK(StyleKeys::classify("opacity") == StyleKeyKind::Passthrough);
+  // Unknown keys fall back to a case-insensitive search
+  CHECK(StyleKeys::classify("thumbCOLOR") == StyleKeyKind::Color);
+}
+
+TEST_CASE("the frame ticker idles once a frame runs out of work") {
+  std::atomic<int> frames{0};
+  FrameTicker ticker(std::chrono::milliseconds(1), [&frames] { return ++frames < 3; });
+  CHECK_FALSE(ticker.ticking());
+
+  ticker.start();
+  REQUIRE(settles(ticker));
+  CHECK(frames == 3);
+
+  // Starting again ticks until the next frame without work
+  ticker.start();
+  REQUIRE(settles(ticker));
+  CHECK(frames == 4);
+
+  // A stopped ticker has joined its thread and doesn't start again
+  ticker.stop();
+  ticker.start();
+  CHECK_FALSE(ticker.ticking());
+  CHECK(frames == 4);
+}
+
+TEST_CASE("animation frames are staged and committed on the ticker's thread") {
+  std::recursive_mutex mutex;
+  double now = 0;
+  AnimationDriver driver([&now] { return now; });
+  ViewStyles views(8);
+  FrameStaging staging;
+  std::vector<double> committed;
+  std::thread::id commitThread;
+
+  AnyObject base;
+  base["opacity"] = 0.5;
+  views.rendered("a", base);
+  views.link("a", true);
+
+  // Mirrors HybridStyleRegistry::animationFrame, nothing waits on a JS thread. The clock
+  // moves 25ms per frame so the frames are known.
+  FrameTicker ticker(std::chrono::milliseconds(1), [&] {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    if (!driver.active()) {
+      return false;
+    }
+    now += 25;
+    for (auto &frame : driver.tick()) {
+      auto changes = views.partial(frame.first, frame.second);
+      if (!changes.empty()) {
+        staging.stage(7, std::move(changes));
+      }
+    }
+    staging.commit([&](FrameStaging::Updates &&updates) {
+      commitThread = std::this_thread::get_id();
+      committed.push_back(std::get<double>(updates.at(7).at("opacity")));
+    });
+    return true;
+  });
+
+  {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    driver.animate("a", {fade()}, {}, base);
+    ticker.start();
+  }
+  REQUIRE(settles(ticker));
+
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  CHECK(commitThread != std::this_thread::get_id());
+  REQUIRE(committed.size() >= 3);
+  CHECK(committed[0] == doctest::Approx(0.25));
+  CHECK(committed[1] == doctest::Approx(0.5));
+  CHECK(committed[2] == doctest::Approx(0.75));
+  // The finished animation restores the base style
+  CHECK(committed.back() == doctest::Approx(0.5));
+  CHECK(staging.empty());
+}
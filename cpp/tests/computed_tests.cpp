@@ -9,9 +9,9 @@
 #include "../Effect.hpp"
 #include "../Observable.hpp"
 
-using nitro::Computed;
-using nitro::Effect;
-using nitro::Observable;
+using reactnativecss::Computed;
+using reactnativecss::Effect;
+using reactnativecss::Observable;
 
 TEST_CASE("computed sum updates from sources") {
   auto a = Observable<int>::create(1);
@@ -278,3 +278,45 @@ TEST_CASE(
   CHECK(computes == 2);
   CHECK(sum->get() == 14);
 }
+
+TEST_CASE("batched source wakes a consumer of two derived computeds once") {
+  struct Rect {
+    int width;
+    int height;
+    bool operator==(const Rect &) const = default;
+  };
+
+  auto rect = Observable<Rect>::create(Rect{1, 1});
+  auto width = Computed<int>::create(
+      [rect](const int &, auto &get) { return get(*rect).width; }, 0);
+  auto height = Computed<int>::create(
+      [rect](const int &, auto &get) { return get(*rect).height; }, 0);
+
+  int runs = 0;
+  int area = 0;
+  Effect spy([&] {
+    ++runs;
+    area = width->get(spy) * height->get(spy);
+  });
+  spy.run();
+  runs = 0;
+
+  Effect::batch([&] { rect->set(Rect{4, 5}); });
+  CHECK(area == 20);
+  CHECK(runs == 1);
+
+  // Only the width changes, height does not notify
+  Effect::batch([&] { rect->set(Rect{2, 5}); });
+  CHECK(area == 10);
+  CHECK(runs == 2);
+}
+
+TEST_CASE("computed first read inside a batch is computed immediately") {
+  auto a = Observable<int>::create(2);
+  auto doubled = Computed<int>::create(
+      [a](const int &, auto &get) { return get(*a) * 2; }, 0);
+
+  int seen = 0;
+  Effect::batch([&] { seen = doubled->get(); });
+  CHECK(seen == 4);
+}
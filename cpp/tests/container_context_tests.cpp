@@ -0,0 +1,56 @@
+// doctest-based tests for container scope resolution and layout records
+#include <doctest/doctest.h>
+
+#include <optional>
+#include <string>
+
+#include "../ContainerContext.hpp"
+
+using margelo::nitro::cssnitro::ContainerContext;
+using margelo::nitro::cssnitro::ResolvedContainer;
+
+TEST_CASE("named containers resolve through the scope hierarchy") {
+  ContainerContext::setScope("cc-card", "root", {"card"});
+  ContainerContext::setScope("cc-child", "cc-card", {});
+
+  const size_t cached = ContainerContext::cacheSize();
+  const ResolvedContainer *card = ContainerContext::resolve("cc-child", std::string("card"));
+  REQUIRE(card != nullptr);
+  CHECK(*card->key == "cc-card");
+
+  // The second lookup is the cached entry
+  CHECK(ContainerContext::resolve("cc-child", std::string("card")) == card);
+  CHECK(ContainerContext::cacheSize() == cached + 1);
+
+  ContainerContext::remove("cc-child");
+  ContainerContext::remove("cc-card");
+}
+
+TEST_CASE("lookups that don't resolve are not cached") {
+  ContainerContext::setScope("cc-lonely", "root", {});
+
+  const size_t cached = ContainerContext::cacheSize();
+  CHECK(ContainerContext::resolve("cc-lonely", std::string("missing")) == nullptr);
+  CHECK(ContainerContext::resolve("cc-unknown", std::string("missing")) == nullptr);
+  CHECK(ContainerContext::cacheSize() == cached);
+
+  ContainerContext::remove("cc-lonely");
+}
+
+TEST_CASE("removing a container only evicts its own lookups") {
+  ContainerContext::setScope("cc-a", "root", {"a"});
+  ContainerContext::setScope("cc-b", "root", {"b"});
+
+  const size_t cached = ContainerContext::cacheSize();
+  const ResolvedContainer *b = ContainerContext::resolve("cc-b", std::string("b"));
+  ContainerContext::resolve("cc-a", std::string("a"));
+  ContainerContext::resolve("cc-a", std::nullopt);
+  CHECK(ContainerContext::cacheSize() == cached + 3);
+
+  ContainerContext::remove("cc-a");
+  CHECK(ContainerContext::cacheSize() == cached + 1);
+  CHECK(ContainerContext::resolve("cc-b", std::string("b")) == b);
+
+  ContainerContext::remove("cc-b");
+  CHECK(ContainerContext::cacheSize() == cached);
+}
@@ -0,0 +1,98 @@
+// doctest-based tests for the pseudo-class state store
+#include <doctest/doctest.h>
+
+#include <memory>
+#include <string>
+
+#include "../Computed.hpp"
+#include "../PseudoClasses.hpp"
+
+using margelo::nitro::cssnitro::PseudoClasses;
+using margelo::nitro::cssnitro::PseudoClassType;
+using reactnativecss::Computed;
+
+namespace {
+
+struct Reader {
+  std::shared_ptr<Computed<bool>> node;
+  std::shared_ptr<int> runs = std::make_shared<int>(0);
+
+  Reader(const std::string &key, PseudoClassType type) {
+    node = Computed<bool>::create(
+        [key, type, runs = runs](const bool &, auto &get) {
+          ++*runs;
+          return PseudoClasses::get(key, type, get);
+        },
+        false);
+  }
+
+  ~Reader() { node->dispose(); }
+};
+
+} // namespace
+
+TEST_CASE("reading or clearing an unset pseudo-class stores nothing") {
+  const size_t keys = PseudoClasses::size();
+  Reader reader("pc-unset", PseudoClassType::ACTIVE);
+  CHECK_FALSE(reader.node->get());
+  PseudoClasses::set("pc-unset", PseudoClassType::HOVER, false);
+  CHECK(PseudoClasses::size() == keys);
+}
+
+TEST_CASE("a key's pseudo-classes share one slot that is reused once removed") {
+  const size_t keys = PseudoClasses::size();
+  PseudoClasses::set("pc-slot", PseudoClassType::ACTIVE, true);
+  PseudoClasses::set("pc-slot", PseudoClassType::FOCUS, true);
+  CHECK(PseudoClasses::size() == keys + 1);
+
+  const size_t capacity = PseudoClasses::capacity();
+  PseudoClasses::remove("pc-slot");
+  CHECK(PseudoClasses::size() == keys);
+  PseudoClasses::set("pc-next", PseudoClassType::HOVER, true);
+  CHECK(PseudoClasses::capacity() == capacity);
+
+  PseudoClasses::remove("pc-next");
+}
+
+TEST_CASE("readers of an unset pseudo-class are woken when it is first set") {
+  Reader reader("pc-first", PseudoClassType::ACTIVE);
+  CHECK_FALSE(reader.node->get());
+
+  PseudoClasses::set("pc-first", PseudoClassType::ACTIVE, true);
+  CHECK(reader.node->get());
+  PseudoClasses::set("pc-first", PseudoClassType::ACTIVE, false);
+  CHECK_FALSE(reader.node->get());
+
+  PseudoClasses::remove("pc-first");
+}
+
+TEST_CASE("flipping one pseudo-class leaves readers of the others alone") {
+  PseudoClasses::set("pc-bits", PseudoClassType::FOCUS, true);
+  Reader hover("pc-bits", PseudoClassType::HOVER);
+  hover.node->get();
+  const int runs = *hover.runs;
+
+  PseudoClasses::set("pc-bits", PseudoClassType::ACTIVE, true);
+  PseudoClasses::set("pc-bits", PseudoClassType::FOCUS, false);
+  CHECK(*hover.runs == runs);
+
+  PseudoClasses::set("pc-bits", PseudoClassType::HOVER, true);
+  CHECK(hover.node->get());
+
+  PseudoClasses::remove("pc-bits");
+}
+
+TEST_CASE("removing a key unsets it for its readers") {
+  PseudoClasses::set("pc-removed", PseudoClassType::HOVER, true);
+  Reader reader("pc-removed", PseudoClassType::HOVER);
+  CHECK(reader.node->get());
+
+  PseudoClasses::remove("pc-removed");
+  CHECK_FALSE(reader.node->get());
+
+  // The reader follows the key once it is set again
+  PseudoClasses::set("pc-removed", PseudoClassType::HOVER, true);
+  CHECK(reader.node->get());
+
+  PseudoClasses::remove("pc-removed");
+}
@@ -0,0 +1,132 @@
+// doctest-based tests for decoding registry command buffers
+#include <doctest/doctest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "../ComponentHandles.hpp"
+#include "../RegistryCommands.hpp"
+
+using margelo::nitro::cssnitro::ComponentHandles;
+using margelo::nitro::cssnitro::RegistryCommand;
+using margelo::nitro::cssnitro::RegistryCommands;
+using margelo::nitro::cssnitro::RegistryOp;
+
+namespace {
+
+std::vector<RegistryCommand> decode(const std::vector<double> &buffer, size_t idCount) {
+  std::vector<RegistryCommand> commands;
+  RegistryCommands::decode(reinterpret_cast<const uint8_t *>(buffer.data()),
+                           buffer.size() * sizeof(double), idCount,
+                           [&](const RegistryCommand &command) { commands.push_back(command); });
+  return commands;
+}
+
+} // namespace
+
+TEST_CASE("commands decode in order with their arguments") {
+  auto commands = decode({5, 0, 0,            // define handle 0 as the first new ID
+                          2, 0, 42,           // link
+                          0, 1, 1, 1,         // hover on
+                          1, 0, 1, 2, 30, 40, // layout
+                          3, 1,               // unlink
+                          4, 0,               // deregister
+                          6, 0},              // release
+                         1);
+
+  REQUIRE(commands.size() == 7);
+  CHECK(commands[0].op == RegistryOp::Define);
+  CHECK(commands[0].args[0] == 0);
+  CHECK(commands[1].op == RegistryOp::Link);
+  CHECK(commands[1].args[0] == 42);
+  CHECK(commands[2].op == RegistryOp::State);
+  CHECK(commands[2].handle == 1);
+  CHECK(commands[2].args[1] == 1);
+  CHECK(commands[3].op == RegistryOp::Layout);
+  CHECK(commands[3].args[3] == 40);
+  CHECK(commands[4].op == RegistryOp::Unlink);
+  CHECK(commands[5].op == RegistryOp::Deregister);
+  CHECK(commands[6].op == RegistryOp::Release);
+}
+
+TEST_CASE("decoding stops at the first malformed command") {
+  // Unknown opcode
+  CHECK(decode({3, 0, 9, 0, 3, 0}, 1).size() == 1);
+  // Handle that isn't an index
+  CHECK(decode({3, 0, 3, -1}, 1).size() == 1);
+  CHECK(decode({3, 0, 3, 0.5}, 1).size() == 1);
+  // Definition of an ID the buffer didn't send
+  CHECK(decode({5, 0, 0, 5, 1, 1}, 1).size() == 1);
+  // Truncated layout
+  CHECK(decode({1, 0, 1, 2}, 1).empty());
+}
+
+TEST_CASE("released handles can be defined for another component") {
+  ComponentHandles handles;
+  handles.define(0, "a");
+  handles.define(1, "b");
+  REQUIRE(handles.find(1) != nullptr);
+  CHECK(*handles.find(1) == "b");
+  CHECK(handles.find(2) == nullptr);
+
+  handles.release(0);
+  CHECK(handles.find(0) == nullptr);
+  CHECK(handles.size() == 1);
+
+  handles.define(0, "c");
+  REQUIRE(handles.find(0) != nullptr);
+  CHECK(*handles.find(0) == "c");
+  CHECK(handles.size() == 2);
+
+  // Releasing twice or an unknown handle does nothing
+  handles.release(1);
+  handles.release(1);
+  handles.release(9);
+  CHECK(handles.size() == 1);
+}
+
+TEST_CASE("state commands only carry known pseudo-classes") {
+  CHECK(decode({0, 0, 2, 1}, 1).size() == 1);
+  // Unknown pseudo-class types
+  CHECK(decode({0, 0, 3, 1}, 1).empty());
+  CHECK(decode({0, 0, -1, 1}, 1).empty());
+  CHECK(decode({0, 0, 1.5, 1}, 1).empty());
+  // Values are booleans
+  CHECK(decode({0, 0, 1, 2}, 1).empty());
+  // Nothing after a rejected command is applied
+  CHECK(decode({3, 0, 0, 0, 7, 0, 3, 0}, 1).size() == 1);
+}
+
+TEST_CASE("truncated and malformed buffers apply only their whole commands") {
+  // A state command missing its value
+  CHECK(decode({3, 0, 0, 0, 1}, 1).size() == 1);
+  // A lone opcode without its handle
+  CHECK(decode({3, 0, 4}, 1).size() == 1);
+  // Handles past the table bound and opcodes that aren't numbers
+  CHECK(decode({4, static_cast<double>(RegistryCommands::kMaxHandles)}, 1).empty());
+  CHECK(decode({std::numeric_limits<double>::quiet_NaN(), 0}, 1).empty());
+  CHECK(decode({4, std::numeric_limits<double>::infinity()}, 1).empty());
+  // No data at all
+  size_t calls = 0;
+  CHECK(RegistryCommands::decode(nullptr, 64, 1, [&](const RegistryCommand &) { calls++; }) == 0);
+  CHECK(calls == 0);
+}
+
+TEST_CASE("buffers are read by whole doubles at any alignment") {
+  std::vector<double> commands{2, 0, 42, 3, 0};
+  // Shift the buffer off double alignment and cut its last double short
+  std::vector<uint8_t> bytes(1 + commands.size() * sizeof(double));
+  std::memcpy(bytes.data() + 1, commands.data(), commands.size() * sizeof(double));
+  const size_t size = commands.size() * sizeof(double) - 3;
+
+  std::vector<RegistryCommand> decoded;
+  RegistryCommands::decode(bytes.data() + 1, size, 0,
+                           [&](const RegistryCommand &command) { decoded.push_back(command); });
+
+  // The unlink lost part of its handle, only the link is whole
+  REQUIRE(decoded.size() == 1);
+  CHECK(decoded[0].op == RegistryOp::Link);
+  CHECK(decoded[0].args[0] == 42);
+}
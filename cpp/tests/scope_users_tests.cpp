@@ -0,0 +1,164 @@
+// doctest-based tests for freeing the state of deregistered components and their scopes
+#include <doctest/doctest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../AnimationDriver.hpp"
+#include "../Animations.hpp"
+#include "../Computed.hpp"
+#include "../ContainerContext.hpp"
+#include "../PseudoClasses.hpp"
+#include "../ScopeUsers.hpp"
+#include "../VariableContext.hpp"
+
+using margelo::nitro::AnyArray;
+using margelo::nitro::AnyMap;
+using margelo::nitro::AnyObject;
+using margelo::nitro::AnyValue;
+using margelo::nitro::cssnitro::AnimationDriver;
+using margelo::nitro::cssnitro::AnimationSpec;
+using margelo::nitro::cssnitro::ContainerContext;
+using margelo::nitro::cssnitro::PseudoClasses;
+using margelo::nitro::cssnitro::PseudoClassType;
+using margelo::nitro::cssnitro::ScopeUsers;
+using margelo::nitro::cssnitro::VariableContext;
+using reactnativecss::Computed;
+
+namespace {
+
+// HybridStyleRegistry::freeScope, the registry itself needs a React Native host
+void freeScope(const std::string &scope) {
+  VariableContext::deleteContext(scope);
+  ContainerContext::remove(scope);
+  reactnativecss::animations::deleteScope(scope);
+}
+
+struct LiveCounts {
+  size_t scopes;
+  size_t variables;
+  size_t containers;
+  size_t pseudoClasses;
+  size_t keyframeScopes;
+  size_t animated;
+
+  bool operator==(const LiveCounts &other) const {
+    return scopes == other.scopes && variables == other.variables &&
+           containers == other.containers && pseudoClasses == other.pseudoClasses &&
+           keyframeScopes == other.keyframeScopes && animated == other.animated;
+  }
+};
+
+LiveCounts liveCounts(const ScopeUsers &users, const AnimationDriver &driver) {
+  return LiveCounts{users.size(),
+                    VariableContext::size(),
+                    ContainerContext::size(),
+                    PseudoClasses::size(),
+                    reactnativecss::animations::scopeCount(),
+                    driver.size()};
+}
+
+// A fade from opacity var(--from) to 1
+void setScopedKeyframes(const std::string &name) {
+  AnyObject from;
+  from["opacity"] = AnyArray{AnyValue(std::string("fn")), AnyValue(std::string("var")),
+                             AnyValue(std::string("from"))};
+  AnyObject to;
+  to["opacity"] = 1.0;
+  auto keyframes = AnyMap::make();
+  keyframes->setObject("from", from);
+  keyframes->setObject("to", to);
+  reactnativecss::animations::setKeyframes(name, keyframes);
+}
+
+AnimationSpec fade() {
+  AnyObject from;
+  from["opacity"] = 0.0;
+  AnyObject to;
+  to["opacity"] = 1.0;
+  AnyObject keyframes;
+  keyframes["from"] = from;
+  keyframes["to"] = to;
+
+  AnimationSpec spec;
+  spec.name = "fade";
+  spec.keyframes = AnimationDriver::parseKeyframes(keyframes);
+  spec.duration = 100;
+  return spec;
+}
+
+} // namespace
+
+TEST_CASE("an owned scope is freed once its owner and last reader are gone") {
+  std::vector<std::string> freed;
+  ScopeUsers users([&](const std::string &scope) { freed.push_back(scope); });
+
+  users.retain("su-parent");
+  users.retain("su-parent");
+  users.orphan("su-parent");
+  CHECK(freed.empty());
+  users.release("su-parent");
+  CHECK(freed.empty());
+  users.release("su-parent");
+  CHECK(freed == std::vector<std::string>{"su-parent"});
+  CHECK(users.size() == 0);
+
+  // Without readers the owner's scope is freed right away, readers alone never free it
+  users.orphan("su-lonely");
+  users.retain("su-root");
+  users.release("su-root");
+  users.release("su-unknown");
+  const std::vector<std::string> expected{"su-parent", "su-lonely"};
+  CHECK(freed == expected);
+}
+
+TEST_CASE("registering then deregistering components returns the live counts to baseline") {
+  double now = 0;
+  AnimationDriver driver([&now] { return now; });
+  ScopeUsers users(freeScope);
+  setScopedKeyframes("su-fade");
+  const LiveCounts baseline = liveCounts(users, driver);
+
+  // A parent that sets a variable, is a container and is animated with keyframes that
+  // read its scope. Like registerComponent, it reads the scopes it is rendered in.
+  users.retain("root");
+  users.retain("root");
+  VariableContext::createContext("su-parent", "root");
+  VariableContext::setVariable("su-parent", "from", AnyValue(0.5));
+  ContainerContext::setScope("su-parent", "root", {"card"});
+  ContainerContext::setLayout("su-parent", 0, 0, 100, 100);
+  PseudoClasses::set("su-parent", PseudoClassType::ACTIVE, true);
+  driver.animate("su-parent", {fade()}, {}, AnyObject{});
+  auto keyframes = Computed<size_t>::create(
+      [](const size_t &, auto &get) {
+        return reactnativecss::animations::getKeyframes("su-fade", "su-parent", get)
+            ->getMap()
+            .size();
+      },
+      0);
+  CHECK(keyframes->get() == 2);
+
+  // A child reading the parent's scopes
+  users.retain("su-parent");
+  users.retain("su-parent");
+  PseudoClasses::set("su-child", PseudoClassType::HOVER, true);
+  CHECK_FALSE(liveCounts(users, driver) == baseline);
+
+  // The parent unmounts first, like deregisterComponent its scope waits for the child
+  keyframes->dispose();
+  users.release("root");
+  users.release("root");
+  PseudoClasses::remove("su-parent");
+  driver.stop("su-parent");
+  users.orphan("su-parent");
+  CHECK(VariableContext::size() > baseline.variables);
+  CHECK(ContainerContext::size() > baseline.containers);
+
+  users.release("su-parent");
+  users.release("su-parent");
+  PseudoClasses::remove("su-child");
+  users.orphan("su-child");
+
+  CHECK(liveCounts(users, driver) == baseline);
+}
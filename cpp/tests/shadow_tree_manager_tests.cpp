@@ -0,0 +1,349 @@
+// doctest-based tests for staging shadow tree updates and rerenders between commits
+#include <doctest/doctest.h>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../AnyValueHash.hpp"
+#include "../ComponentTags.hpp"
+#include "../Computed.hpp"
+#include "../PendingStyles.hpp"
+#include "../PseudoClasses.hpp"
+#include "../RerenderQueue.hpp"
+#include "../ShadowTreeStaging.hpp"
+#include "../StyleDiff.hpp"
+#include "../ViewStyles.hpp"
+
+using margelo::nitro::AnyArray;
+using margelo::nitro::AnyObject;
+using margelo::nitro::AnyValue;
+using margelo::nitro::cssnitro::AnyValueHash;
+using margelo::nitro::cssnitro::CommitStats;
+using margelo::nitro::cssnitro::ComponentTags;
+using margelo::nitro::cssnitro::PendingStyles;
+using margelo::nitro::cssnitro::PseudoClasses;
+using margelo::nitro::cssnitro::PseudoClassType;
+using margelo::nitro::cssnitro::RerenderQueue;
+using margelo::nitro::cssnitro::ShadowTreeStaging;
+using margelo::nitro::cssnitro::StyleDiff;
+using margelo::nitro::cssnitro::ViewStyles;
+using reactnativecss::Computed;
+
+namespace {
+
+using Props = std::map<std::string, int>;
+
+struct PropsTraits {
+  static void merge(Props &into, Props &&from) {
+    for (auto &entry : from) {
+      into[entry.first] = entry.second;
+    }
+  }
+
+  static size_t count(const Props &payload) { return payload.size(); }
+};
+
+using Staging = ShadowTreeStaging<int, Props, PropsTraits>;
+
+} // namespace
+
+TEST_CASE("updates staged for one tag merge with later properties winning") {
+  Staging staging;
+  staging.stage(1, Props{{"opacity", 0}, {"width", 10}});
+  staging.stage(1, Props{{"opacity", 1}});
+  staging.stage(2, Props{{"height", 5}});
+  CHECK(staging.size() == 2);
+
+  Staging::Updates applied;
+  int calls = 0;
+  CommitStats stats = staging.commit([&](Staging::Updates &&updates) {
+    ++calls;
+    applied = std::move(updates);
+  });
+
+  CHECK(calls == 1);
+  CHECK(stats.tags == 2);
+  CHECK(stats.properties == 3);
+  CHECK(applied[1]["opacity"] == 1);
+  CHECK(applied[1]["width"] == 10);
+  CHECK(staging.empty());
+}
+
+TEST_CASE("committing nothing does not apply") {
+  Staging staging;
+  int calls = 0;
+  CommitStats stats = staging.commit([&](Staging::Updates &&) { ++calls; });
+  CHECK(calls == 0);
+  CHECK(stats.tags == 0);
+  CHECK(stats.properties == 0);
+}
+
+TEST_CASE("updates staged while applying wait for the next commit") {
+  Staging staging;
+  staging.stage(1, Props{{"opacity", 0}});
+  staging.commit([&](Staging::Updates &&) { staging.stage(1, Props{{"opacity", 1}}); });
+  CHECK(staging.size() == 1);
+
+  Staging::Updates applied;
+  staging.commit([&](Staging::Updates &&updates) { applied = std::move(updates); });
+  CHECK(applied[1]["opacity"] == 1);
+}
+
+TEST_CASE("full styles only send changed and removed keys") {
+  AnyObject sent;
+  AnyObject style;
+  style["opacity"] = 1.0;
+  style["color"] = std::string("red");
+  CHECK(StyleDiff::full(sent, style).size() == 2);
+
+  // Nothing changed, nothing to send
+  CHECK(StyleDiff::full(sent, style).empty());
+
+  AnyObject hovered;
+  hovered["opacity"] = 0.5;
+  AnyObject changes = StyleDiff::full(sent, hovered);
+  CHECK(changes.size() == 2);
+  CHECK(std::get<double>(changes.at("opacity")) == 0.5);
+  CHECK(std::holds_alternative<std::monostate>(changes.at("color")));
+  CHECK(sent.count("color") == 0);
+}
+
+TEST_CASE("partial styles leave unmentioned keys alone") {
+  AnyObject sent;
+  sent["opacity"] = 0.0;
+  sent["width"] = 10.0;
+
+  AnyObject frame;
+  frame["opacity"] = 0.0;
+  CHECK(StyleDiff::partial(sent, frame).empty());
+
+  frame["opacity"] = 0.25;
+  AnyObject changes = StyleDiff::partial(sent, frame);
+  CHECK(changes.size() == 1);
+  CHECK(std::get<double>(sent.at("opacity")) == 0.25);
+  CHECK(sent.count("width") == 1);
+}
+
+TEST_CASE("updates of unlinked components are parked until taken") {
+  PendingStyles pending(2);
+
+  AnyObject frame;
+  frame["opacity"] = 0.5;
+  pending.merge("a", frame);
+  auto parked = pending.take("a");
+  REQUIRE(parked.has_value());
+  CHECK_FALSE(parked->full);
+  CHECK(std::get<double>(parked->style.at("opacity")) == 0.5);
+  CHECK_FALSE(pending.take("a").has_value());
+
+  // A frame over a full style keeps it full
+  AnyObject style;
+  style["width"] = 10.0;
+  pending.replace("b", style);
+  pending.merge("b", frame);
+  parked = pending.take("b");
+  REQUIRE(parked.has_value());
+  CHECK(parked->full);
+  CHECK(parked->style.size() == 2);
+}
+
+TEST_CASE("the pending buffer drops the oldest component past its capacity") {
+  PendingStyles pending(2);
+  AnyObject style;
+  style["width"] = 10.0;
+  pending.replace("a", style);
+  pending.replace("b", style);
+  pending.replace("c", style);
+
+  CHECK(pending.size() == 2);
+  CHECK_FALSE(pending.take("a").has_value());
+  CHECK(pending.take("c").has_value());
+
+  pending.erase("b");
+  CHECK(pending.size() == 0);
+}
+
+TEST_CASE("a linked view starts out with the style it rendered with") {
+  ViewStyles views(2);
+  AnyObject rendered;
+  rendered["color"] = std::string("red");
+  rendered["opacity"] = 1.0;
+  views.rendered("a", rendered);
+  CHECK(views.link("a", true).empty());
+
+  // The key set at registration is reset once it is dropped
+  AnyObject hovered;
+  hovered["opacity"] = 0.5;
+  AnyObject changes = views.full("a", hovered);
+  CHECK(changes.size() == 2);
+  CHECK(std::holds_alternative<std::monostate>(changes.at("color")));
+  CHECK(std::get<double>(changes.at("opacity")) == 0.5);
+}
+
+TEST_CASE("updates parked before the link are replayed against the rendered style") {
+  ViewStyles views(2);
+  AnyObject rendered;
+  rendered["color"] = std::string("red");
+  views.rendered("a", rendered);
+
+  AnyObject hovered;
+  hovered["opacity"] = 0.5;
+  CHECK(views.full("a", hovered).empty());
+  CHECK_FALSE(views.isLinked("a"));
+
+  AnyObject changes = views.link("a", true);
+  CHECK(changes.size() == 2);
+  CHECK(std::holds_alternative<std::monostate>(changes.at("color")));
+
+  // A relinked view starts out with the latest rendered style
+  views.unlink("a");
+  views.rendered("a", hovered);
+  CHECK(views.link("a", false).empty());
+  views.remove("a");
+  CHECK(views.size() == 0);
+}
+
+TEST_CASE("rerenders requested in a batch are delivered once per component") {
+  RerenderQueue rerenders;
+  std::vector<std::vector<std::string>> deliveries;
+  rerenders.setHandler(
+      [&](const std::vector<std::string> &componentIds) { deliveries.push_back(componentIds); });
+
+  reactnativecss::Effect::batch([&]() {
+    rerenders.request("a", nullptr);
+    rerenders.request("b", nullptr);
+    rerenders.request("a", nullptr);
+    CHECK(deliveries.empty());
+  });
+
+  REQUIRE(deliveries.size() == 1);
+  REQUIRE(deliveries[0].size() == 2);
+  CHECK(deliveries[0][0] == "a");
+  CHECK(deliveries[0][1] == "b");
+  CHECK(rerenders.size() == 0);
+
+  // Outside of a batch a request is delivered immediately
+  rerenders.request("c", nullptr);
+  CHECK(deliveries.size() == 2);
+}
+
+TEST_CASE("without a handler each component's callback is called") {
+  RerenderQueue rerenders;
+  int calls = 0;
+  reactnativecss::Effect::batch([&]() {
+    rerenders.request("a", [&] { ++calls; });
+    rerenders.request("a", [&] { ++calls; });
+    rerenders.request("b", [&] { ++calls; });
+    rerenders.cancel("b");
+  });
+  CHECK(calls == 1);
+}
+
+TEST_CASE("a native handler's state flip is staged before it returns") {
+  // The registry's pieces for one pressable component: its view tag, the style its view
+  // holds, the restyle computed from its :active state, staging and rerenders
+  ComponentTags<int> tags;
+  ViewStyles views(8);
+  Staging staging;
+  RerenderQueue rerenders;
+  std::recursive_mutex mutex;
+
+  // Stands in for the JS thread, rerenders are handed to it rather than delivered
+  std::vector<std::function<void()>> jsThread;
+  std::vector<std::string> rerendered;
+  rerenders.setDispatch([&](std::function<void()> &&deliver) { jsThread.push_back(deliver); });
+  rerenders.setHandler([&](const std::vector<std::string> &ids) {
+    rerendered.insert(rerendered.end(), ids.begin(), ids.end());
+  });
+
+  auto style = [](double opacity) {
+    AnyObject style;
+    style["opacity"] = opacity;
+    return style;
+  };
+  views.rendered("press-a", style(100));
+  views.link("press-a", true);
+  tags.link("press-a", 7);
+
+  auto restyle = Computed<int>::create(
+      [&](const int &runs, auto &get) {
+        bool active = PseudoClasses::get("press-a", PseudoClassType::ACTIVE, get);
+        auto changes = views.full("press-a", style(active ? 50 : 100));
+        Props props;
+        for (const auto &entry : changes) {
+          props[entry.first] = static_cast<int>(std::get<double>(entry.second));
+        }
+        if (!props.empty()) {
+          staging.stage(7, std::move(props));
+          rerenders.request("press-a", nullptr);
+        }
+        return runs + 1;
+      },
+      0);
+  // Registering reads the style once, which subscribes it
+  CHECK(restyle->get() == 1);
+  CHECK(staging.empty());
+
+  // Mirrors HybridStyleRegistry::updateComponentStateForTag, called on a native thread
+  auto press = [&](int tag, bool value) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    const std::string *componentId = tags.find(tag);
+    if (componentId == nullptr) return false;
+    std::string id = *componentId;
+    reactnativecss::Effect::batch(
+        [&]() { PseudoClasses::set(id, PseudoClassType::ACTIVE, value); });
+    return true;
+  };
+
+  bool pressed = false;
+  std::thread touch([&] { pressed = press(7, true); });
+  touch.join();
+  REQUIRE(pressed);
+
+  // The restyle is staged by the time the handler returns, only the rerender waits for JS
+  std::vector<Staging::Updates> applied;
+  staging.commit([&](Staging::Updates &&updates) { applied.push_back(std::move(updates)); });
+  REQUIRE(applied.size() == 1);
+  CHECK(applied[0][7]["opacity"] == 50);
+  CHECK(rerendered.empty());
+  REQUIRE(jsThread.size() == 1);
+  jsThread[0]();
+  CHECK(rerendered == std::vector<std::string>{"press-a"});
+
+  // Nothing is linked to other tags
+  CHECK_FALSE(press(8, false));
+  CHECK(staging.empty());
+
+  restyle->dispose();
+  PseudoClasses::remove("press-a");
+}
+
+TEST_CASE("equal values hash equal whatever their object's entry order") {
+  AnyValueHash hash;
+
+  AnyObject first;
+  first["translateX"] = 10.0;
+  first["rotate"] = std::string("45deg");
+  first["scale"] = AnyArray{AnyValue(1.0), AnyValue(2.0)};
+  AnyObject second;
+  second["scale"] = AnyArray{AnyValue(1.0), AnyValue(2.0)};
+  second["rotate"] = std::string("45deg");
+  second["translateX"] = 10.0;
+
+  REQUIRE(AnyValue(first) == AnyValue(second));
+  CHECK(hash(AnyValue(first)) == hash(AnyValue(second)));
+  CHECK(hash(AnyValue(0.0)) == hash(AnyValue(-0.0)));
+
+  // Values of different types or element order are not equal, and these hash apart
+  size_t doubleOne = hash(AnyValue(1.0));
+  size_t intOne = hash(AnyValue(int64_t{1}));
+  CHECK(doubleOne != intOne);
+  size_t ordered = hash(AnyValue(AnyArray{AnyValue(1.0), AnyValue(2.0)}));
+  size_t reversed = hash(AnyValue(AnyArray{AnyValue(2.0), AnyValue(1.0)}));
+  CHECK(ordered != reversed);
+}
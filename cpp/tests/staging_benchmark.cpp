@@ -0,0 +1,108 @@
+// Sweeps payload sizes through ShadowTreeStaging and reports what each commit cost.
+//
+// The payloads are the AnyObject styles the registry stages before converting them to
+// folly::dynamic, and the apply callback moves them out the way applyUpdates hands them to
+// updateShadowTree. CommitStats::duration only times that callback, so the report also
+// times the whole commit (swap, counting and apply). Neither includes the UIManager commit
+// or mounting, which need a running React Native host.
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <NitroModules/AnyMap.hpp>
+
+#include "../ShadowTreeStaging.hpp"
+
+using margelo::nitro::AnyArray;
+using margelo::nitro::AnyObject;
+using margelo::nitro::cssnitro::CommitStats;
+using margelo::nitro::cssnitro::ShadowTreeStaging;
+
+namespace {
+
+struct StyleTraits {
+  static void merge(AnyObject &into, AnyObject &&from) {
+    for (auto &entry : from) {
+      into[entry.first] = std::move(entry.second);
+    }
+  }
+
+  static size_t count(const AnyObject &payload) { return payload.size(); }
+};
+
+using Staging = ShadowTreeStaging<int, AnyObject, StyleTraits>;
+
+// A style of the given size, mixing the value kinds of real declarations
+AnyObject makeStyle(size_t properties, size_t restyle) {
+  AnyObject style;
+  for (size_t i = 0; i < properties; i++) {
+    auto key = "prop" + std::to_string(i);
+    switch (i % 3) {
+      case 0:
+        style[key] = static_cast<double>(i + restyle);
+        break;
+      case 1:
+        style[key] = std::string("rgba(0, 0, 0, 0.5)");
+        break;
+      default: {
+        AnyObject rotate;
+        rotate["rotate"] = std::to_string(restyle) + "deg";
+        style[key] = AnyArray{rotate};
+        break;
+      }
+    }
+  }
+  return style;
+}
+
+} // namespace
+
+int main() {
+  constexpr int kRuns = 20;
+
+  std::printf("%8s %8s %8s %10s %14s %14s\n", "tags", "props", "restyles", "staged",
+              "apply (us)", "commit (us)");
+
+  for (size_t tags : {1, 10, 100, 1000}) {
+    for (size_t properties : {1, 10, 50}) {
+      // Restyles of the same tag between commits are merged into one payload
+      for (size_t restyles : {1, 4}) {
+        double apply = 0;
+        double commit = 0;
+        CommitStats stats;
+        for (int run = 0; run < kRuns; run++) {
+          Staging staging;
+          for (size_t restyle = 0; restyle < restyles; restyle++) {
+            for (size_t tag = 0; tag < tags; tag++) {
+              staging.stage(static_cast<int>(tag), makeStyle(properties, restyle));
+            }
+          }
+
+          std::vector<AnyObject> tree;
+          tree.reserve(tags);
+          auto start = std::chrono::steady_clock::now();
+          stats = staging.commit([&](Staging::Updates &&updates) {
+            for (auto &entry : updates) {
+              tree.push_back(std::move(entry.second));
+            }
+          });
+          auto end = std::chrono::steady_clock::now();
+
+          if (stats.tags != tags || stats.properties != tags * properties) {
+            std::fprintf(stderr, "unexpected commit of %zu tags and %zu properties\n",
+                         stats.tags, stats.properties);
+            return 1;
+          }
+          apply += std::chrono::duration<double, std::micro>(stats.duration).count();
+          commit += std::chrono::duration<double, std::micro>(end - start).count();
+        }
+
+        std::printf("%8zu %8zu %8zu %10zu %14.2f %14.2f\n", tags, properties, restyles,
+                    stats.properties, apply / kRuns, commit / kRuns);
+      }
+    }
+  }
+  return 0;
+}
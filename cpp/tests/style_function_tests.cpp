@@ -0,0 +1,197 @@
+// doctest-based tests for style value resolution: variables, units and calc()
+#include <doctest/doctest.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "../Computed.hpp"
+#include "../Environment.hpp"
+#include "../StyleFunction.hpp"
+#include "../StyleResolver.hpp"
+#include "../VariableContext.hpp"
+
+using margelo::nitro::AnyArray;
+using margelo::nitro::AnyMap;
+using margelo::nitro::AnyObject;
+using margelo::nitro::AnyValue;
+using margelo::nitro::cssnitro::AnyValuePtr;
+using margelo::nitro::cssnitro::StyleFunction;
+using margelo::nitro::cssnitro::StyleResolver;
+using margelo::nitro::cssnitro::VariableContext;
+using reactnativecss::Computed;
+
+namespace {
+
+// Resolve a declaration value in scope, as a style recompute would
+std::shared_ptr<Computed<AnyValuePtr>> resolve(AnyValue value, const std::string &scope) {
+  return Computed<AnyValuePtr>::create(
+      [value = std::move(value), scope](const AnyValuePtr &, auto &get) -> AnyValuePtr {
+        AnyValuePtr holder;
+        const AnyValue &resolved = StyleResolver::resolveStyle(value, scope, get, holder);
+        if (holder || std::holds_alternative<std::monostate>(resolved)) {
+          return holder;
+        }
+        return std::make_shared<const AnyValue>(resolved);
+      },
+      nullptr);
+}
+
+AnyValue fn(AnyArray args) {
+  args.insert(args.begin(), AnyValue(std::string("fn")));
+  return AnyValue(std::move(args));
+}
+
+AnyValue str(const char *value) { return AnyValue(std::string(value)); }
+
+} // namespace
+
+TEST_CASE("a resolved variable is the node the scope holds, not a copy") {
+  VariableContext::createContext("sf-shared", "root");
+  VariableContext::setVariable("sf-shared", "variant",
+                               AnyValue(AnyArray{str("small-caps"), str("tabular-nums")}));
+
+  auto lookup = Computed<AnyValuePtr>::create(
+      [](const AnyValuePtr &, auto &get) {
+        return VariableContext::getVariable("sf-shared", "variant", get);
+      },
+      nullptr);
+  auto style = resolve(fn({str("var"), str("variant")}), "sf-shared");
+
+  REQUIRE(lookup->get() != nullptr);
+  CHECK(style->get() == lookup->get());
+
+  // Shared values are mapped into the style without going through a copy of the merged map
+  std::unordered_map<std::string, AnyValuePtr> merged{
+      {"fontVariant", style->get()}, {"rotate", std::make_shared<const AnyValue>(str("45deg"))}};
+  auto mapped = Computed<std::shared_ptr<AnyMap>>::create(
+      [&merged](const std::shared_ptr<AnyMap> &, auto &get) {
+        return StyleResolver::applyStyleMapping(merged, "sf-shared", get);
+      },
+      nullptr);
+  CHECK(mapped->get()->getAny("fontVariant") == *lookup->get());
+  CHECK(mapped->get()->contains("transform"));
+
+  mapped->dispose();
+  style->dispose();
+  lookup->dispose();
+  VariableContext::deleteContext("sf-shared");
+}
+
+TEST_CASE("arrays of objects resolve as themselves, not as units") {
+  AnyObject offset{{"width", AnyValue(1.0)}, {"height", AnyValue(2.0)}};
+  AnyValue shadows(AnyArray{AnyValue(offset), AnyValue(offset)});
+  auto style = resolve(shadows, "root");
+  REQUIRE(style->get() != nullptr);
+  CHECK(*style->get() == shadows);
+  style->dispose();
+}
+
+TEST_CASE("rem, vw, vh and em follow the environment") {
+  namespace env = reactnativecss::env;
+  env::setWindowDimensions(400, 800, 2, 1);
+  env::setRem(16);
+
+  auto unit = [](const char *name, double value) {
+    AnyArray args{AnyValue(AnyObject{}), str(name), AnyValue(value)};
+    if (std::string(name) != "rem") {
+      args.emplace_back(1.0);
+    }
+    return AnyValue(std::move(args));
+  };
+  auto number = [](const std::shared_ptr<Computed<AnyValuePtr>> &node) {
+    const AnyValuePtr &value = node->get();
+    return value && std::holds_alternative<double>(*value) ? std::get<double>(*value) : -1.0;
+  };
+
+  VariableContext::createContext("sf-units", "root");
+  auto rem = resolve(unit("rem", 2), "sf-units");
+  auto vw = resolve(unit("vw", 50), "sf-units");
+  auto vh = resolve(unit("vh", 25), "sf-units");
+  auto em = resolve(unit("em", 2), "sf-units");
+  CHECK(number(rem) == 32);
+  CHECK(number(vw) == 200);
+  CHECK(number(vh) == 200);
+  // Without an inherited font size em falls back to rem
+  CHECK(number(em) == 32);
+
+  // A stylesheet's rem and a window resize update the resolved values
+  env::setRem(10);
+  CHECK(number(rem) == 20);
+  CHECK(number(em) == 20);
+  env::setWindowDimensions(1000, 500, 2, 1);
+  CHECK(number(vw) == 500);
+  CHECK(number(vh) == 125);
+
+  // em follows the font size set in scope
+  VariableContext::setVariable("sf-units", "__rn-css-em", AnyValue(12.0));
+  CHECK(number(em) == 24);
+
+  for (auto *node : {&rem, &vw, &vh, &em}) {
+    (*node)->dispose();
+  }
+  VariableContext::deleteContext("sf-units");
+  env::setRem(14);
+  env::setWindowDimensions(0, 0, 0, 0);
+}
+
+namespace {
+
+// Fold a single declaration value the way stylesheets are folded on load
+AnyValue folded(const AnyValue &value) {
+  auto declarations = AnyMap::make(1);
+  declarations->setAny("width", value);
+  return StyleFunction::foldConstants(declarations)->getAny("width");
+}
+
+AnyValue num(double value) { return AnyValue(value); }
+
+} // namespace
+
+TEST_CASE("constant calc functions fold to their result") {
+  CHECK(folded(fn({str("sum"), num(10), num(5)})) == num(15));
+  CHECK(folded(fn({str("product"), num(2), num(-3)})) == num(-6));
+  CHECK(folded(fn({str("min"), num(3), num(1), num(2)})) == num(1));
+  CHECK(folded(fn({str("max"), num(3), num(1), num(2)})) == num(3));
+  CHECK(folded(fn({str("clamp"), num(0), num(5), num(3)})) == num(3));
+  CHECK(folded(fn({str("clamp"), num(4), num(1), num(8)})) == num(4));
+  CHECK(folded(fn({str("abs"), num(-4)})) == num(4));
+  CHECK(folded(fn({str("sign"), num(-4)})) == num(-1));
+  CHECK(folded(fn({str("sign"), num(0)})) == num(0));
+
+  // calc(2 * (10px + 5px)) as the compiler emits it, with the argument spread into calc
+  CHECK(folded(fn({str("calc"), str("fn"), str("product"), num(2),
+                   fn({str("sum"), num(10), num(5)})})) == num(30));
+}
+
+TEST_CASE("percentages fold with themselves but not with lengths") {
+  CHECK(folded(fn({str("sum"), str("50%"), str("25%")})) == str("75%"));
+  CHECK(folded(fn({str("product"), num(2), str("25%")})) == str("50%"));
+  CHECK(folded(fn({str("max"), str("10%"), str("20%")})) == str("20%"));
+
+  // A length and a percentage can only be resolved against layout, they are kept
+  AnyValue mixed = fn({str("sum"), str("100%"), num(-10)});
+  CHECK(folded(mixed) == mixed);
+  AnyValue mixedMin = fn({str("min"), str("50%"), num(100)});
+  CHECK(folded(mixedMin) == mixedMin);
+}
+
+TEST_CASE("folding keeps var() leaves and resolves them at runtime") {
+  // calc(2 * 3px + var(--gap))
+  AnyValue gap = fn({str("var"), str("gap")});
+  AnyValue expression = fn({str("sum"), fn({str("product"), num(2), num(3)}), gap});
+  AnyValue partial = folded(expression);
+  CHECK(partial == fn({str("sum"), num(6), gap}));
+
+  VariableContext::createContext("sf-calc", "root");
+  VariableContext::setVariable("sf-calc", "gap", num(4));
+  auto width = resolve(partial, "sf-calc");
+  REQUIRE(width->get() != nullptr);
+  CHECK(*width->get() == num(10));
+
+  VariableContext::setVariable("sf-calc", "gap", num(8));
+  CHECK(*width->get() == num(14));
+
+  width->dispose();
+  VariableContext::deleteContext("sf-calc");
+}
@@ -0,0 +1,108 @@
+// doctest-based tests for variable scopes and memoized variable lookups
+#include <doctest/doctest.h>
+
+#include <memory>
+#include <string>
+
+#include "../Computed.hpp"
+#include "../Environment.hpp"
+#include "../VariableContext.hpp"
+
+using margelo::nitro::AnyArray;
+using margelo::nitro::AnyObject;
+using margelo::nitro::AnyValue;
+using margelo::nitro::cssnitro::AnyValuePtr;
+using margelo::nitro::cssnitro::VariableContext;
+using reactnativecss::Computed;
+
+namespace {
+
+// A lookup of name from scope, as a style recompute would read it
+std::shared_ptr<Computed<AnyValuePtr>> lookup(const std::string &scope, const std::string &name) {
+  return Computed<AnyValuePtr>::create(
+      [scope, name](const AnyValuePtr &, auto &get) {
+        return VariableContext::getVariable(scope, name, get);
+      },
+      nullptr);
+}
+
+std::string text(const AnyValuePtr &value) {
+  if (!value || !std::holds_alternative<std::string>(*value)) {
+    return "";
+  }
+  return std::get<std::string>(*value);
+}
+
+} // namespace
+
+TEST_CASE("a variable changed in a parent scope reaches lookups from its children") {
+  VariableContext::createContext("vc-parent", "root");
+  VariableContext::createContext("vc-child", "vc-parent");
+  VariableContext::setVariable("vc-parent", "accent", AnyValue(std::string("red")));
+
+  auto accent = lookup("vc-child", "accent");
+  CHECK(text(accent->get()) == "red");
+
+  VariableContext::setVariable("vc-parent", "accent", AnyValue(std::string("blue")));
+  CHECK(text(accent->get()) == "blue");
+
+  // The child's own value shadows the parent's
+  VariableContext::setVariable("vc-child", "accent", AnyValue(std::string("green")));
+  CHECK(text(accent->get()) == "green");
+
+  accent->dispose();
+  VariableContext::deleteContext("vc-child");
+  VariableContext::deleteContext("vc-parent");
+}
+
+TEST_CASE("a deleted scope releases its lookup nodes") {
+  VariableContext::createContext("vc-owner", "root");
+  VariableContext::createContext("vc-owned", "vc-owner");
+  auto owned = lookup("vc-owned", "gap");
+  owned->get();
+  CHECK(VariableContext::resolved.count("vc-owned") == 1);
+
+  owned->dispose();
+  VariableContext::deleteContext("vc-owned");
+  VariableContext::deleteContext("vc-owner");
+  CHECK(VariableContext::resolved.count("vc-owned") == 0);
+  CHECK(VariableContext::children.count("vc-owner") == 0);
+  CHECK(VariableContext::contexts.count("vc-owner") == 0);
+}
+
+TEST_CASE("lookups from a scope without a context are released with it") {
+  // Components without variables read through their parent's key, which may never
+  // have been created
+  auto unknown = lookup("vc-never-created", "gap");
+  CHECK(unknown->get() == nullptr);
+  CHECK(VariableContext::resolved.count("vc-never-created") == 1);
+
+  unknown->dispose();
+  VariableContext::deleteContext("vc-never-created");
+  CHECK(VariableContext::resolved.count("vc-never-created") == 0);
+}
+
+TEST_CASE("a root variable takes the first value whose media matches") {
+  reactnativecss::env::setWindowDimensions(400, 800, 1, 1);
+
+  // [{ v: "wide", m: { "min-width": ["=", 600] } }, { v: "narrow" }]
+  AnyObject wideMedia{{"min-width", AnyValue(AnyArray{AnyValue(std::string("=")), AnyValue(600.0)})}};
+  AnyObject wide{{"v", AnyValue(std::string("wide"))}, {"m", AnyValue(wideMedia)}};
+  AnyObject narrow{{"v", AnyValue(std::string("narrow"))}};
+  VariableContext::setTopLevelVariable("root", "vc-layout",
+                                       AnyValue(AnyArray{AnyValue(wide), AnyValue(narrow)}));
+
+  VariableContext::createContext("vc-media", "root");
+  auto layout = lookup("vc-media", "vc-layout");
+  CHECK(text(layout->get()) == "narrow");
+
+  reactnativecss::env::setWindowDimensions(800, 400, 1, 1);
+  CHECK(text(layout->get()) == "wide");
+
+  reactnativecss::env::setWindowDimensions(400, 800, 1, 1);
+  CHECK(text(layout->get()) == "narrow");
+
+  layout->dispose();
+  VariableContext::deleteContext("vc-media");
+  reactnativecss::env::setWindowDimensions(0, 0, 0, 0);
+}
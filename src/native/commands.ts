@@ -0,0 +1,137 @@
+import { StyleRegistry, type PseudoClassType } from "../specs/StyleRegistry";
+
+/**
+ * Registry operations are encoded into a Float64Array and submitted in a single call,
+ * once all the work of the current React commit has queued its commands. Each command is
+ * [opcode, handle, ...args]. A handle is a number standing in for a component ID, the ID
+ * string is only sent once, with the command defining its handle.
+ * Must match RegistryCommands.hpp.
+ */
+const OP_STATE = 0; // [handle, type, value]
+const OP_LAYOUT = 1; // [handle, x, y, width, height]
+const OP_LINK = 2; // [handle, tag]
+const OP_UNLINK = 3; // [handle]
+const OP_DEREGISTER = 4; // [handle]
+const OP_DEFINE = 5; // [handle, index into the submitted component IDs]
+const OP_RELEASE = 6; // [handle]
+
+const PSEUDO_CLASS_TYPES: Record<PseudoClassType, number> = {
+  active: 0,
+  hover: 1,
+  focus: 2,
+};
+
+let buffer = new Float64Array(256);
+let length = 0;
+let scheduled = false;
+
+// Handles outlive a submission, released ones are reused so they stay small
+const handles = new Map<string, number>();
+const releasedHandles: number[] = [];
+let nextHandle = 0;
+// The IDs given a handle since the last submission
+let definedIds: string[] = [];
+
+function write(opcode: number, handle: number, ...args: number[]) {
+  const size = 2 + args.length;
+  if (buffer.length < length + size) {
+    const next = new Float64Array(Math.max(buffer.length * 2, length + size));
+    next.set(buffer);
+    buffer = next;
+  }
+
+  buffer[length++] = opcode;
+  buffer[length++] = handle;
+  for (const arg of args) {
+    buffer[length++] = arg;
+  }
+
+  if (!scheduled) {
+    scheduled = true;
+    queueMicrotask(flushCommands);
+  }
+}
+
+function handleFor(componentId: string) {
+  let handle = handles.get(componentId);
+  if (handle === undefined) {
+    handle = releasedHandles.pop() ?? nextHandle++;
+    handles.set(componentId, handle);
+    write(OP_DEFINE, handle, definedIds.length);
+    definedIds.push(componentId);
+  }
+  return handle;
+}
+
+function push(opcode: number, componentId: string, ...args: number[]) {
+  write(opcode, handleFor(componentId), ...args);
+}
+
+/**
+ * Set a pseudo-class and submit the buffer right away. State changes are press, hover and
+ * focus feedback, so they are applied within the event rather than on the next microtask.
+ * Commands queued before it are submitted with it, in order.
+ */
+export function setComponentState(
+  componentId: string,
+  type: PseudoClassType,
+  value: boolean,
+) {
+  push(OP_STATE, componentId, PSEUDO_CLASS_TYPES[type], value ? 1 : 0);
+  flushCommands();
+}
+
+export function queueComponentLayoutCommand(
+  componentId: string,
+  x: number,
+  y: number,
+  width: number,
+  height: number,
+) {
+  push(OP_LAYOUT, componentId, x, y, width, height);
+}
+
+export function queueComponentLink(componentId: string, tag: number) {
+  push(OP_LINK, componentId, tag);
+}
+
+export function queueComponentUnlink(componentId: string) {
+  // A component without a handle was never linked through the buffer
+  const handle = handles.get(componentId);
+  if (handle !== undefined) {
+    write(OP_UNLINK, handle);
+  }
+}
+
+export function queueComponentDeregister(componentId: string) {
+  push(OP_DEREGISTER, componentId);
+}
+
+/**
+ * Release the component's handle once it unmounts, commands queued for it before are
+ * still applied.
+ */
+export function queueComponentRelease(componentId: string) {
+  const handle = handles.get(componentId);
+  if (handle !== undefined) {
+    write(OP_RELEASE, handle);
+    handles.delete(componentId);
+    releasedHandles.push(handle);
+  }
+}
+
+export function flushCommands() {
+  scheduled = false;
+
+  if (length === 0) {
+    return;
+  }
+
+  const commands = buffer.slice(0, length).buffer;
+  const ids = definedIds;
+
+  length = 0;
+  definedIds = [];
+
+  StyleRegistry.submitCommands(commands, ids);
+}
@@ -0,0 +1,87 @@
+import type { LayoutChangeEvent } from "react-native";
+
+import { StyleRegistry } from "../specs/StyleRegistry";
+
+const RECORD_SIZE = 4;
+
+let pendingIds: string[] = [];
+let pendingLayouts = new Map<string, number>();
+let buffer = new Float64Array(64 * RECORD_SIZE);
+let scheduled = false;
+
+/**
+ * Queue a layout update. All layouts queued within the same frame are sent to
+ * the StyleRegistry in a single call and applied in one batch. Only the last
+ * layout of each component is kept.
+ */
+export function queueComponentLayout(
+  componentId: string,
+  layout: LayoutChangeEvent["nativeEvent"]["layout"],
+) {
+  let index = pendingLayouts.get(componentId);
+
+  if (index === undefined) {
+    index = pendingIds.length;
+    pendingIds.push(componentId);
+    pendingLayouts.set(componentId, index);
+
+    if (buffer.length < pendingIds.length * RECORD_SIZE) {
+      const next = new Float64Array(buffer.length * 2);
+      next.set(buffer);
+      buffer = next;
+    }
+  }
+
+  const offset = index * RECORD_SIZE;
+  buffer[offset] = layout.x;
+  buffer[offset + 1] = layout.y;
+  buffer[offset + 2] = layout.width;
+  buffer[offset + 3] = layout.height;
+
+  if (!scheduled) {
+    scheduled = true;
+    requestAnimationFrame(flushComponentLayouts);
+  }
+}
+
+/**
+ * Drop a queued layout, e.g. when the component unmounts before the frame
+ */
+export function cancelComponentLayout(componentId: string) {
+  const index = pendingLayouts.get(componentId);
+  if (index === undefined) {
+    return;
+  }
+
+  // Move the last record into the cancelled one's slot
+  const last = pendingIds.length - 1;
+  if (index !== last) {
+    const lastId = pendingIds[last]!;
+    pendingIds[index] = lastId;
+    pendingLayouts.set(lastId, index);
+    buffer.copyWithin(
+      index * RECORD_SIZE,
+      last * RECORD_SIZE,
+      (last + 1) * RECORD_SIZE,
+    );
+  }
+
+  pendingIds.pop();
+  pendingLayouts.delete(componentId);
+}
+
+export function flushComponentLayouts() {
+  scheduled = false;
+
+  if (pendingIds.length === 0) {
+    return;
+  }
+
+  const ids = pendingIds;
+  const layouts = buffer.slice(0, ids.length * RECORD_SIZE).buffer;
+
+  pendingIds = [];
+  pendingLayouts = new Map();
+
+  StyleRegistry.updateComponentLayouts(ids, layouts);
+}
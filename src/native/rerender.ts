@@ -0,0 +1,45 @@
+import { unstable_batchedUpdates } from "react-native";
+
+const rerenders = new Map<string, () => void>();
+let pendingIds = new Set<string>();
+let scheduled = false;
+
+/**
+ * Remember how to rerender a component, so the StyleRegistry can rerender it by ID.
+ */
+export function setComponentRerender(componentId: string, rerender: () => void) {
+  rerenders.set(componentId, rerender);
+}
+
+export function deleteComponentRerender(componentId: string) {
+  rerenders.delete(componentId);
+  pendingIds.delete(componentId);
+}
+
+/**
+ * Queue the components the StyleRegistry asked to rerender. All requests of the same
+ * frame are rendered together in a single React update.
+ */
+export function queueComponentRerenders(componentIds: string[]) {
+  for (const componentId of componentIds) {
+    pendingIds.add(componentId);
+  }
+
+  if (!scheduled && pendingIds.size > 0) {
+    scheduled = true;
+    requestAnimationFrame(flushComponentRerenders);
+  }
+}
+
+export function flushComponentRerenders() {
+  scheduled = false;
+
+  const ids = pendingIds;
+  pendingIds = new Set();
+
+  unstable_batchedUpdates(() => {
+    for (const componentId of ids) {
+      rerenders.get(componentId)?.();
+    }
+  });
+}
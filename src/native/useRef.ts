@@ -1,6 +1,6 @@
 import { useCallback } from "react";
 
-import { StyleRegistry } from "../specs/StyleRegistry";
+import { queueComponentLink, queueComponentUnlink } from "./commands";
 
 export function useDualRefs(componentId: string, existingRef?: any): any {
   return useCallback(
@@ -12,11 +12,11 @@ export function useDualRefs(componentId: string, existingRef?: any): any {
       }
 
       if (handle?.__nativeTag) {
-        StyleRegistry.linkComponent(componentId, handle.__nativeTag);
+        queueComponentLink(componentId, handle.__nativeTag);
       }
 
       return () => {
-        StyleRegistry.unlinkComponent(componentId);
+        queueComponentUnlink(componentId);
       };
     },
     [existingRef, componentId],
@@ -1,8 +1,16 @@
 import { use, useEffect, useMemo, useReducer } from "react";
+import type { LayoutChangeEvent } from "react-native";
 
 import { StyleRegistry, type Declarations } from "../specs/StyleRegistry";
 import { testAttributeQuery } from "./attributeQuery";
+import {
+  queueComponentDeregister,
+  queueComponentRelease,
+  setComponentState,
+} from "./commands";
 import { ContainerContext, VariableContext } from "./contexts";
+import { cancelComponentLayout, queueComponentLayout } from "./layout";
+import { deleteComponentRerender, setComponentRerender } from "./rerender";
 
 const EMPTY_DECLARATIONS: Declarations = {};
 const REDUCER = <T>(state: T) => ({ ...state });
@@ -14,6 +22,7 @@ export function useStyledProps(
   isDisabled = false,
 ) {
   const [instance, rerender] = useReducer(REDUCER, EMPTY_DECLARATIONS);
+  setComponentRerender(componentId, rerender);
 
   let variableScope = use(VariableContext);
   let containerScope = use(ContainerContext);
@@ -76,9 +85,17 @@ export function useStyledProps(
     ...componentData.importantProps,
   };
 
+  if (declarations.containerScope) {
+    p.onLayout = onLayout(componentId, originalProps);
+  }
+
   useEffect(
     () => () => {
-      // StyleRegistry.deregisterComponent(componentId);
+      deleteComponentRerender(componentId);
+      cancelComponentLayout(componentId);
+      // Deregistering goes through the handle, so it is queued before the release
+      queueComponentDeregister(componentId);
+      queueComponentRelease(componentId);
     },
     [componentId],
   );
@@ -113,32 +130,38 @@ export function useStyledProps(
   };
 }
 
+const onLayout =
+  (id: string, props: Record<string, any>) => (event: LayoutChangeEvent) => {
+    props.onLayout?.(event);
+    queueComponentLayout(id, event.nativeEvent.layout);
+  };
+
 const onPressIn = (id: string, props: Record<string, any>) => () => {
   props.onPressIn?.();
-  StyleRegistry.updateComponentState(id, "active", true);
+  setComponentState(id, "active", true);
 };
 
 const onPressOut = (id: string, props: Record<string, any>) => () => {
   props.onPressIn?.();
-  StyleRegistry.updateComponentState(id, "active", false);
+  setComponentState(id, "active", false);
 };
 
 const onHoverIn = (id: string, props: Record<string, any>) => () => {
   props.onHoverIn?.();
-  StyleRegistry.updateComponentState(id, "hover", true);
+  setComponentState(id, "hover", true);
 };
 
 const onHoverOut = (id: string, props: Record<string, any>) => () => {
   props.onHoverOut?.();
-  StyleRegistry.updateComponentState(id, "hover", false);
+  setComponentState(id, "hover", false);
 };
 
 const onFocus = (id: string, props: Record<string, any>) => () => {
   props.onFocus?.();
-  StyleRegistry.updateComponentState(id, "focus", true);
+  setComponentState(id, "focus", true);
 };
 
 const onBlur = (id: string, props: Record<string, any>) => () => {
   props.onBlur?.();
-  StyleRegistry.updateComponentState(id, "focus", false);
+  setComponentState(id, "focus", false);
 };
@@ -48,6 +48,11 @@ export interface StyleRegistry
   ): Styled;
   setClassname(classname: string, styleRule: HybridStyleRule[]): void;
   setKeyframes(name: string, keyframes: AnyMap): void;
+  /**
+   * Receive the components to rerender, deduplicated and delivered once per native batch.
+   * Without a handler, each component's own `rerender` callback is called.
+   */
+  setRerenderHandler(handler: (componentIds: string[]) => void): void;
   setRootVariables(variables: AnyMap): void;
   setUniversalVariables(variables: AnyMap): void;
   setWindowDimensions(
@@ -61,6 +66,11 @@ export interface StyleRegistry
     inlineStyleKeys: string[],
   ): void;
   updateComponentLayout(componentId: string, value: LayoutRectangle): void;
+  /**
+   * Apply many layouts in a single batch.
+   * `layouts` is a Float64Array buffer of [x, y, width, height] records, one per componentId.
+   */
+  updateComponentLayouts(componentIds: string[], layouts: ArrayBuffer): void;
   updateComponentState(
     componentId: string,
     type: PseudoClassType,
@@ -74,6 +84,12 @@ export interface StyleRegistry
  */
 export interface RawStyleRegistry {
   linkComponent(componentId: string, tag: number): void;
+  /**
+   * Apply a buffer of encoded commands in a single batch, see `src/native/commands.ts`.
+   * `commands` is a Float64Array buffer, commands refer to components by handle.
+   * `componentIds` are the IDs given a handle by this buffer, in definition order.
+   */
+  submitCommands(commands: ArrayBuffer, componentIds: string[]): void;
   registerExternalMethods(options: { processColor: typeof processColor }): void;
 }
 
@@ -2,6 +2,8 @@ import { Dimensions, processColor } from "react-native";
 
 import { NitroModules } from "react-native-nitro-modules";
 
+import { queueComponentRerenders } from "../../native/rerender";
+
 import type {
   HybridStyleRegistry,
   JSStyleRegistry,
@@ -27,3 +29,5 @@ Dimensions.addEventListener("change", ({ window }) => {
 StyleRegistry.registerExternalMethods({
   processColor,
 });
+
+StyleRegistry.setRerenderHandler(queueComponentRerenders);